@@ -1,6 +1,10 @@
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -12,34 +16,85 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <charconv>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
-#include <sstream>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <string.h>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 using namespace llvm;
 using namespace llvm::sys;
 
-FILE *pFile;
+//===----------------------------------------------------------------------===//
+// Identifier interner
+//===----------------------------------------------------------------------===//
+
+// Every identifier spelling is interned once into a compact SymbolID. Tokens,
+// AST nodes and codegen tables carry the ID, so comparing two names is an
+// integer compare and only the first sighting of a name allocates.
+//
+// The table is shared by every Lexer in the process and is guarded by a mutex.
+// Each Lexer keeps its own cache in front of it, so the lock is only taken the
+// first time a lexer sees a spelling.
+typedef uint32_t SymbolID;
+
+class SymbolTable {
+  StringMap<SymbolID> IDs;
+  std::vector<StringRef> Names; // Indexed by SymbolID, points at keys in IDs
+  mutable std::mutex Lock;
+
+public:
+  SymbolID intern(StringRef Name) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    auto Entry = IDs.try_emplace(Name, Names.size());
+    if (Entry.second)
+      Names.push_back(Entry.first->getKey());
+    return Entry.first->getValue();
+  }
+  StringRef name(SymbolID ID) const {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Names[ID];
+  }
+  size_t size() const {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Names.size();
+  }
+};
 
+static SymbolTable Symbols;
 
 //===----------------------------------------------------------------------===//
 // Lexer
@@ -106,308 +161,706 @@ enum TOKEN_TYPE {
   INVALID = -100 // signal invalid token
 };
 
+// Keywords - each spelling and the token it lexes to. To add a keyword, add a
+// row here: the lookup table below is regenerated at compile time.
+struct Keyword {
+  const char *Spelling;
+  int Tok;
+};
+
+static constexpr Keyword Keywords[] = {
+    {"int", INT_TOK},   {"bool", BOOL_TOK},   {"float", FLOAT_TOK},
+    {"void", VOID_TOK}, {"extern", EXTERN},   {"if", IF},
+    {"else", ELSE},     {"while", WHILE},     {"return", RETURN},
+    {"true", BOOL_LIT}, {"false", BOOL_LIT},
+};
+
+static constexpr size_t constexprStrlen(const char *Str) {
+  size_t Len = 0;
+  while (Str[Len] != '\0')
+    Len++;
+  return Len;
+}
+
+static constexpr size_t maxKeywordLength() {
+  size_t Max = 0;
+  for (const Keyword &K : Keywords)
+    Max = std::max(Max, constexprStrlen(K.Spelling));
+  return Max;
+}
+
+static constexpr size_t MaxKeywordLength = maxKeywordLength();
+static constexpr unsigned KeywordTableSize = 32;
+
+// Hash of an identifier from its first char, last char and length
+static constexpr unsigned keywordHash(unsigned Seed, unsigned char First,
+                                      unsigned char Last, size_t Len) {
+  return (First * Seed + Last + Len) % KeywordTableSize;
+}
+
+static constexpr bool isPerfectKeywordSeed(unsigned Seed) {
+  bool Used[KeywordTableSize] = {};
+  for (const Keyword &K : Keywords) {
+    size_t Len = constexprStrlen(K.Spelling);
+    unsigned H = keywordHash(Seed, K.Spelling[0], K.Spelling[Len - 1], Len);
+    if (Used[H])
+      return false;
+    Used[H] = true;
+  }
+  return true;
+}
+
+// Searches for a seed under which no two keywords share a table slot
+static constexpr unsigned findKeywordSeed() {
+  for (unsigned Seed = 1; Seed < 1024; Seed++)
+    if (isPerfectKeywordSeed(Seed))
+      return Seed;
+  return 0;
+}
+
+static constexpr unsigned KeywordSeed = findKeywordSeed();
+static_assert(KeywordSeed != 0,
+              "no perfect hash for Keywords, increase KeywordTableSize");
+
+struct KeywordSlot {
+  const char *Spelling = nullptr;
+  size_t Len = 0; // 0 marks an empty slot
+  int Tok = IDENT;
+};
+
+static constexpr std::array<KeywordSlot, KeywordTableSize> buildKeywordTable() {
+  std::array<KeywordSlot, KeywordTableSize> Table{};
+  for (const Keyword &K : Keywords) {
+    size_t Len = constexprStrlen(K.Spelling);
+    KeywordSlot &Slot =
+        Table[keywordHash(KeywordSeed, K.Spelling[0], K.Spelling[Len - 1], Len)];
+    Slot.Spelling = K.Spelling;
+    Slot.Len = Len;
+    Slot.Tok = K.Tok;
+  }
+  return Table;
+}
+
+static constexpr std::array<KeywordSlot, KeywordTableSize> KeywordTable =
+    buildKeywordTable();
+
+// Returns the keyword token for Ident, or IDENT if it is not a keyword. One
+// table probe and at most one memcmp regardless of how many keywords exist.
+static int classifyIdentifier(StringRef Ident) {
+  size_t Len = Ident.size();
+  if (Len > MaxKeywordLength)
+    return IDENT;
+  const KeywordSlot &Slot =
+      KeywordTable[keywordHash(KeywordSeed, Ident.front(), Ident.back(), Len)];
+  if (Slot.Len == Len && memcmp(Slot.Spelling, Ident.data(), Len) == 0)
+    return Slot.Tok;
+  return IDENT;
+}
+
 // TOKEN struct is used to keep track of information about a token
 struct TOKEN {
   int type = -100;
-  std::string lexeme;
-  int lineNo;
-  int columnNo;
+  StringRef lexeme; // Points into the Lexer's buffer, no copy is made
+  union {             // Which member is filled in depends on type
+    SymbolID sym = 0; // Interned name if IDENT
+    int intVal;       // Value if INT_LIT
+    float floatVal;   // Value if FLOAT_LIT
+    bool boolVal;     // Value if BOOL_LIT
+  };
 };
 
-static std::string IdentifierStr; // Filled in if IDENT
-static int IntVal;                // Filled in if INT_LIT
-static bool BoolVal;              // Filled in if BOOL_LIT
-static float FloatVal;            // Filled in if FLOAT_LIT
-static std::string StringVal;     // Filled in if String Literal
-static int lineNo, columnNo;
+// The lexer is a table-driven DFA. Every input byte is first mapped to a
+// character class, and the DFA state and class index the transition table.
+// Both tables are built at compile time. The classes follow the "C" locale
+// meaning of isspace/isalpha/isdigit, which is what the lexer always used.
+enum CharClass : uint8_t {
+  CC_OTHER,   // anything not listed below, returned as its ascii value
+  CC_SPACE,   // ' ', '\t', '\v', '\f'
+  CC_NEWLINE, // '\n', '\r'
+  CC_ALPHA,   // [a-zA-Z_]
+  CC_DIGIT,   // [0-9]
+  CC_DOT,     // '.'
+  CC_SLASH,   // '/'
+  CC_EQUALS,  // '='
+  CC_BANG,    // '!'
+  CC_LESS,    // '<'
+  CC_GREATER, // '>'
+  CC_AMP,     // '&'
+  CC_PIPE,    // '|'
+  CC_PUNCT,   // single character tokens { } ( ) ; , + - * %
+  NUM_CHAR_CLASSES
+};
 
-static TOKEN returnTok(std::string lexVal, int tok_type) {
-  TOKEN return_tok;
-  return_tok.lexeme = lexVal;
-  return_tok.type = tok_type;
-  return_tok.lineNo = lineNo;
-  return_tok.columnNo = columnNo - lexVal.length() - 1;
-  return return_tok;
+static constexpr std::array<uint8_t, 256> buildCharClasses() {
+  std::array<uint8_t, 256> Classes{};
+  for (int c = 'a'; c <= 'z'; c++)
+    Classes[c] = CC_ALPHA;
+  for (int c = 'A'; c <= 'Z'; c++)
+    Classes[c] = CC_ALPHA;
+  Classes['_'] = CC_ALPHA;
+  for (int c = '0'; c <= '9'; c++)
+    Classes[c] = CC_DIGIT;
+  Classes[' '] = Classes['\t'] = Classes['\v'] = Classes['\f'] = CC_SPACE;
+  Classes['\n'] = Classes['\r'] = CC_NEWLINE;
+  Classes['.'] = CC_DOT;
+  Classes['/'] = CC_SLASH;
+  Classes['='] = CC_EQUALS;
+  Classes['!'] = CC_BANG;
+  Classes['<'] = CC_LESS;
+  Classes['>'] = CC_GREATER;
+  Classes['&'] = CC_AMP;
+  Classes['|'] = CC_PIPE;
+  for (unsigned char c : {'{', '}', '(', ')', ';', ',', '+', '-', '*', '%'})
+    Classes[c] = CC_PUNCT;
+  return Classes;
 }
 
-// Read file line by line -- or look for \n and if found add 1 to line number
-// and reset column number to 0
-/// gettok - Return the next token from standard input.
-static TOKEN gettok() {
-
-  static int LastChar = ' ';
-  static int NextChar = ' ';
-
-  // Skip any whitespace.
-  while (isspace(LastChar)) {
-    if (LastChar == '\n' || LastChar == '\r') {
-      lineNo++;
-      columnNo = 1;
-    }
-    LastChar = getc(pFile);
-    columnNo++;
-  }
-
-  if (isalpha(LastChar) ||
-      (LastChar == '_')) { // identifier: [a-zA-Z_][a-zA-Z_0-9]*
-    IdentifierStr = LastChar;
-    columnNo++;
-
-    while (isalnum((LastChar = getc(pFile))) || (LastChar == '_')) {
-      IdentifierStr += LastChar;
-      columnNo++;
-    }
-
-    if (IdentifierStr == "int")
-      return returnTok("int", INT_TOK);
-    if (IdentifierStr == "bool")
-      return returnTok("bool", BOOL_TOK);
-    if (IdentifierStr == "float")
-      return returnTok("float", FLOAT_TOK);
-    if (IdentifierStr == "void")
-      return returnTok("void", VOID_TOK);
-    if (IdentifierStr == "bool")
-      return returnTok("bool", BOOL_TOK);
-    if (IdentifierStr == "extern")
-      return returnTok("extern", EXTERN);
-    if (IdentifierStr == "if")
-      return returnTok("if", IF);
-    if (IdentifierStr == "else")
-      return returnTok("else", ELSE);
-    if (IdentifierStr == "while")
-      return returnTok("while", WHILE);
-    if (IdentifierStr == "return")
-      return returnTok("return", RETURN);
-    if (IdentifierStr == "true") {
-      BoolVal = true;
-      return returnTok("true", BOOL_LIT);
-    }
-    if (IdentifierStr == "false") {
-      BoolVal = false;
-      return returnTok("false", BOOL_LIT);
-    }
-
-    return returnTok(IdentifierStr.c_str(), IDENT);
-  }
-
-  if (LastChar == '=') {
-    NextChar = getc(pFile);
-    if (NextChar == '=') { // EQ: ==
-      LastChar = getc(pFile);
-      columnNo += 2;
-      return returnTok("==", EQ);
-    } else {
-      LastChar = NextChar;
-      columnNo++;
-      return returnTok("=", ASSIGN);
-    }
-  }
+static constexpr std::array<uint8_t, 256> CharClasses = buildCharClasses();
+
+// DFA states. S_ERROR is the dead state: the lexer stops on the transition
+// into it and accepts whatever the state it was in accepts.
+enum LexState : uint8_t {
+  S_ERROR,
+  S_START,
+  S_IDENT,   // [a-zA-Z_][a-zA-Z_0-9]*
+  S_INT,     // [0-9]+
+  S_FLOAT,   // [0-9]+.[0-9]* or .[0-9]*
+  S_ASSIGN,  // =
+  S_EQ,      // ==
+  S_NOT,     // !
+  S_NE,      // !=
+  S_LT,      // <
+  S_LE,      // <=
+  S_GT,      // >
+  S_GE,      // >=
+  S_AMP,     // &
+  S_AND,     // &&
+  S_PIPE,    // |
+  S_OR,      // ||
+  S_DIV,     // /
+  S_COMMENT, // //, the rest of the line is skipped outside the DFA
+  S_CHAR,    // any other single character
+  NUM_LEX_STATES
+};
 
-  if (LastChar == '{') {
-    LastChar = getc(pFile);
-    columnNo++;
-    return returnTok("{", LBRA);
-  }
-  if (LastChar == '}') {
-    LastChar = getc(pFile);
-    columnNo++;
-    return returnTok("}", RBRA);
-  }
-  if (LastChar == '(') {
-    LastChar = getc(pFile);
-    columnNo++;
-    return returnTok("(", LPAR);
+// Accepting token for each state. Two pseudo tokens mark states whose token
+// is not fixed: the first byte's ascii value, or a comment to be skipped.
+static constexpr int TOK_FIRST_CHAR = INVALID - 1;
+static constexpr int TOK_COMMENT = INVALID - 2;
+
+static constexpr std::array<int, NUM_LEX_STATES> buildAcceptTable() {
+  std::array<int, NUM_LEX_STATES> Accept{};
+  Accept[S_ERROR] = INVALID;
+  Accept[S_START] = INVALID;
+  Accept[S_IDENT] = IDENT;
+  Accept[S_INT] = INT_LIT;
+  Accept[S_FLOAT] = FLOAT_LIT;
+  Accept[S_ASSIGN] = ASSIGN;
+  Accept[S_EQ] = EQ;
+  Accept[S_NOT] = NOT;
+  Accept[S_NE] = NE;
+  Accept[S_LT] = LT;
+  Accept[S_LE] = LE;
+  Accept[S_GT] = GT;
+  Accept[S_GE] = GE;
+  Accept[S_AMP] = TOK_FIRST_CHAR;
+  Accept[S_AND] = AND;
+  Accept[S_PIPE] = TOK_FIRST_CHAR;
+  Accept[S_OR] = OR;
+  Accept[S_DIV] = DIV;
+  Accept[S_COMMENT] = TOK_COMMENT;
+  Accept[S_CHAR] = TOK_FIRST_CHAR;
+  return Accept;
+}
+
+static constexpr std::array<int, NUM_LEX_STATES> AcceptTable =
+    buildAcceptTable();
+
+typedef std::array<std::array<uint8_t, NUM_CHAR_CLASSES>, NUM_LEX_STATES>
+    TransitionTable;
+
+static constexpr TransitionTable buildTransitions() {
+  TransitionTable Next{}; // every transition not set below goes to S_ERROR
+  // Whitespace is skipped before the DFA starts, so S_START never sees it
+  Next[S_START][CC_OTHER] = S_CHAR;
+  Next[S_START][CC_PUNCT] = S_CHAR;
+  Next[S_START][CC_ALPHA] = S_IDENT;
+  Next[S_START][CC_DIGIT] = S_INT;
+  Next[S_START][CC_DOT] = S_FLOAT;
+  Next[S_START][CC_EQUALS] = S_ASSIGN;
+  Next[S_START][CC_BANG] = S_NOT;
+  Next[S_START][CC_LESS] = S_LT;
+  Next[S_START][CC_GREATER] = S_GT;
+  Next[S_START][CC_AMP] = S_AMP;
+  Next[S_START][CC_PIPE] = S_PIPE;
+  Next[S_START][CC_SLASH] = S_DIV;
+
+  Next[S_IDENT][CC_ALPHA] = S_IDENT;
+  Next[S_IDENT][CC_DIGIT] = S_IDENT;
+  Next[S_INT][CC_DIGIT] = S_INT;
+  Next[S_INT][CC_DOT] = S_FLOAT;
+  Next[S_FLOAT][CC_DIGIT] = S_FLOAT;
+
+  Next[S_ASSIGN][CC_EQUALS] = S_EQ;
+  Next[S_NOT][CC_EQUALS] = S_NE;
+  Next[S_LT][CC_EQUALS] = S_LE;
+  Next[S_GT][CC_EQUALS] = S_GE;
+  Next[S_AMP][CC_AMP] = S_AND;
+  Next[S_PIPE][CC_PIPE] = S_OR;
+  Next[S_DIV][CC_SLASH] = S_COMMENT;
+  return Next;
+}
+
+static constexpr TransitionTable Transitions = buildTransitions();
+
+// Whitespace and comment scanning. Indentation and // comment banners are
+// most of the bytes in generated sources, so these two scans have SSE2 and
+// AVX2 kernels that look at 16 or 32 bytes per step. The widest one the CPU
+// supports is picked once at startup; the scalar versions serve every other
+// target and the last few bytes of the buffer.
+
+// Finds the first byte at or after Ptr that is not whitespace, or End.
+typedef const char *(*SkipWhitespaceFn)(const char *Ptr, const char *End);
+// Finds the first '\n' or '\r' at or after Ptr, or End.
+typedef const char *(*FindLineEndFn)(const char *Ptr, const char *End);
+
+static const char *skipWhitespaceScalar(const char *Ptr, const char *End) {
+  uint8_t Class;
+  while (Ptr != End && ((Class = CharClasses[(unsigned char)*Ptr]) == CC_SPACE ||
+                        Class == CC_NEWLINE))
+    Ptr++;
+  return Ptr;
+}
+
+static const char *findLineEndScalar(const char *Ptr, const char *End) {
+  while (Ptr != End && *Ptr != '\n' && *Ptr != '\r')
+    Ptr++;
+  return Ptr;
+}
+
+#if defined(__x86_64__)
+// SSE2 is part of the x86-64 baseline, so this needs no runtime check
+static const char *skipWhitespaceSSE2(const char *Ptr, const char *End) {
+  const __m128i Space = _mm_set1_epi8(' ');
+  const __m128i Tab = _mm_set1_epi8('\t');
+  const __m128i Four = _mm_set1_epi8(4);
+  while (End - Ptr >= 16) {
+    __m128i Chunk = _mm_loadu_si128((const __m128i *)Ptr);
+    // '\t' '\n' '\v' '\f' '\r' are 9..13, so c - 9 <= 4 unsigned finds them
+    __m128i Ctrl = _mm_sub_epi8(Chunk, Tab);
+    __m128i IsCtrl = _mm_cmpeq_epi8(_mm_min_epu8(Ctrl, Four), Ctrl);
+    __m128i IsSpace = _mm_or_si128(IsCtrl, _mm_cmpeq_epi8(Chunk, Space));
+    uint32_t NotSpace = ~_mm_movemask_epi8(IsSpace) & 0xFFFF;
+    if (NotSpace != 0)
+      return Ptr + __builtin_ctz(NotSpace);
+    Ptr += 16;
   }
-  if (LastChar == ')') {
-    LastChar = getc(pFile);
-    columnNo++;
-    return returnTok(")", RPAR);
+  return skipWhitespaceScalar(Ptr, End);
+}
+
+static const char *findLineEndSSE2(const char *Ptr, const char *End) {
+  const __m128i LF = _mm_set1_epi8('\n');
+  const __m128i CR = _mm_set1_epi8('\r');
+  while (End - Ptr >= 16) {
+    __m128i Chunk = _mm_loadu_si128((const __m128i *)Ptr);
+    uint32_t NewlineMask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(Chunk, LF), _mm_cmpeq_epi8(Chunk, CR)));
+    if (NewlineMask != 0)
+      return Ptr + __builtin_ctz(NewlineMask);
+    Ptr += 16;
   }
-  if (LastChar == ';') {
-    LastChar = getc(pFile);
-    columnNo++;
-    return returnTok(";", SC);
+  return findLineEndScalar(Ptr, End);
+}
+
+__attribute__((target("avx2"))) static const char *
+skipWhitespaceAVX2(const char *Ptr, const char *End) {
+  const __m256i Space = _mm256_set1_epi8(' ');
+  const __m256i Tab = _mm256_set1_epi8('\t');
+  const __m256i Four = _mm256_set1_epi8(4);
+  while (End - Ptr >= 32) {
+    __m256i Chunk = _mm256_loadu_si256((const __m256i *)Ptr);
+    __m256i Ctrl = _mm256_sub_epi8(Chunk, Tab);
+    __m256i IsCtrl = _mm256_cmpeq_epi8(_mm256_min_epu8(Ctrl, Four), Ctrl);
+    __m256i IsSpace =
+        _mm256_or_si256(IsCtrl, _mm256_cmpeq_epi8(Chunk, Space));
+    uint32_t NotSpace = ~(uint32_t)_mm256_movemask_epi8(IsSpace);
+    if (NotSpace != 0)
+      return Ptr + __builtin_ctz(NotSpace);
+    Ptr += 32;
   }
-  if (LastChar == ',') {
-    LastChar = getc(pFile);
-    columnNo++;
-    return returnTok(",", COMMA);
+  return skipWhitespaceSSE2(Ptr, End);
+}
+
+__attribute__((target("avx2"))) static const char *
+findLineEndAVX2(const char *Ptr, const char *End) {
+  const __m256i LF = _mm256_set1_epi8('\n');
+  const __m256i CR = _mm256_set1_epi8('\r');
+  while (End - Ptr >= 32) {
+    __m256i Chunk = _mm256_loadu_si256((const __m256i *)Ptr);
+    uint32_t NewlineMask = _mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpeq_epi8(Chunk, LF), _mm256_cmpeq_epi8(Chunk, CR)));
+    if (NewlineMask != 0)
+      return Ptr + __builtin_ctz(NewlineMask);
+    Ptr += 32;
   }
+  return findLineEndSSE2(Ptr, End);
+}
 
-  if (isdigit(LastChar) || LastChar == '.') { // Number: [0-9]+.
-    std::string NumStr;
+static bool cpuHasAVX2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
 
-    if (LastChar == '.') { // Floatingpoint Number: .[0-9]+
-      do {
-        NumStr += LastChar;
-        LastChar = getc(pFile);
-        columnNo++;
-      } while (isdigit(LastChar));
+static const SkipWhitespaceFn SkipWhitespace =
+    cpuHasAVX2() ? skipWhitespaceAVX2 : skipWhitespaceSSE2;
+static const FindLineEndFn FindLineEnd =
+    cpuHasAVX2() ? findLineEndAVX2 : findLineEndSSE2;
+#else
+static const SkipWhitespaceFn SkipWhitespace = skipWhitespaceScalar;
+static const FindLineEndFn FindLineEnd = findLineEndScalar;
+#endif
+
+struct TokenStream;
+
+// Lexer - all the state needed to lex one file. Lexers share nothing but the
+// SymbolTable, so any number of them can run at once on different threads.
+//
+// The whole input file is held in one MemoryBuffer, which mmaps regular files
+// and falls back to a single bulk read for pipes and stdin. The buffer is
+// always followed by a '\0', so the lexer can look one byte ahead without
+// bounds checks. Token lexemes are StringRefs pointing back into this buffer,
+// so the Lexer must outlive every token it hands out.
+class Lexer {
+  std::unique_ptr<MemoryBuffer> Buf;
+  const char *CurPtr; // Next byte the lexer will look at
+  const char *BufEnd; // One past the last byte of the file
+
+  // Byte offset of the first character of each line, built the first time a
+  // diagnostic needs a line and column. The lexer never tracks positions.
+  std::vector<uint32_t> LineStarts;
+
+  // Spellings this lexer has already interned, checked before Symbols
+  StringMap<SymbolID> LocalSymbols;
+
+  TOKEN returnTok(const char *TokStart, int tok_type);
+  TOKEN returnIntTok(const char *TokStart);
+  TOKEN returnFloatTok(const char *TokStart);
+  SymbolID intern(StringRef Name);
 
-      FloatVal = strtof(NumStr.c_str(), nullptr);
-      return returnTok(NumStr, FLOAT_LIT);
-    } else {
-      do { // Start of Number: [0-9]+
-        NumStr += LastChar;
-        LastChar = getc(pFile);
-        columnNo++;
-      } while (isdigit(LastChar));
-
-      if (LastChar == '.') { // Floatingpoint Number: [0-9]+.[0-9]+)
-        do {
-          NumStr += LastChar;
-          LastChar = getc(pFile);
-          columnNo++;
-        } while (isdigit(LastChar));
-
-        FloatVal = strtof(NumStr.c_str(), nullptr);
-        return returnTok(NumStr, FLOAT_LIT);
-      } else { // Integer : [0-9]+
-        IntVal = strtod(NumStr.c_str(), nullptr);
-        return returnTok(NumStr, INT_LIT);
-      }
+public:
+  Lexer(std::unique_ptr<MemoryBuffer> Buffer)
+      : Buf(std::move(Buffer)), CurPtr(Buf->getBufferStart()),
+        BufEnd(Buf->getBufferEnd()) {}
+
+  TOKEN gettok();
+  TokenStream tokenize();
+  std::pair<unsigned, unsigned> getLineAndColumn(const char *Ptr);
+  TOKEN LogErrorAt(const char *Ptr, std::string Str);
+  StringRef getBuffer() const { return Buf->getBuffer(); }
+};
+
+// Builds a token whose lexeme is the bytes from TokStart up to CurPtr
+TOKEN Lexer::returnTok(const char *TokStart, int tok_type) {
+  TOKEN return_tok;
+  return_tok.sym = 0;
+  return_tok.lexeme = StringRef(TokStart, CurPtr - TokStart);
+  return_tok.type = tok_type;
+  return return_tok;
+}
+
+// Literals are converted straight out of the buffer with std::from_chars, so
+// no string is built and the locale is never consulted. The DFA has already
+// checked the spelling, only the range can still be wrong.
+TOKEN Lexer::returnIntTok(const char *TokStart) {
+  TOKEN tok = returnTok(TokStart, INT_LIT);
+  if (std::from_chars(TokStart, CurPtr, tok.intVal).ec != std::errc())
+    throw LogErrorAt(TokStart, "Lexical Error: integer literal " +
+                                   tok.lexeme.str() + " is out of range");
+  return tok;
+}
+
+// std::from_chars also fails a float literal too small for a float, which
+// rounds to zero or a denormal instead, so only an overflow is out of range.
+// The DFA accepts a lone "." as a float literal, which has no digits at all.
+TOKEN Lexer::returnFloatTok(const char *TokStart) {
+  TOKEN tok = returnTok(TokStart, FLOAT_LIT);
+  if (std::from_chars(TokStart, CurPtr, tok.floatVal,
+                      std::chars_format::fixed).ec == std::errc())
+    return tok;
+  APFloat Val(APFloat::IEEEsingle());
+  auto Status = Val.convertFromString(tok.lexeme, APFloat::rmNearestTiesToEven);
+  if (errorToBool(Status.takeError()))
+    throw LogErrorAt(TokStart, "Lexical Error: malformed float literal " +
+                                   tok.lexeme.str());
+  if (*Status & APFloat::opOverflow)
+    throw LogErrorAt(TokStart, "Lexical Error: float literal " +
+                                   tok.lexeme.str() + " is out of range");
+  tok.floatVal = Val.convertToFloat();
+  return tok;
+}
+
+SymbolID Lexer::intern(StringRef Name) {
+  auto Entry = LocalSymbols.try_emplace(Name, 0);
+  if (Entry.second)
+    Entry.first->second = Symbols.intern(Name);
+  return Entry.first->second;
+}
+
+// Maps a position in the buffer to a 1-based line and column. The line
+// start index is built on the first call, one FindLineEnd scan per line;
+// "\r\n", "\n" and a lone "\r" each end a line.
+std::pair<unsigned, unsigned> Lexer::getLineAndColumn(const char *Ptr) {
+  const char *Start = Buf->getBufferStart();
+  uint32_t Offset = Ptr - Start;
+  if (LineStarts.empty()) {
+    LineStarts.push_back(0);
+    for (const char *Ptr = FindLineEnd(Start, BufEnd); Ptr != BufEnd;
+         Ptr = FindLineEnd(Ptr, BufEnd)) {
+      Ptr += (Ptr[0] == '\r' && Ptr[1] == '\n') ? 2 : 1;
+      LineStarts.push_back(Ptr - Start);
     }
   }
+  auto Line = std::upper_bound(LineStarts.begin(), LineStarts.end(), Offset);
+  unsigned LineIndex = Line - LineStarts.begin() - 1;
+  return {LineIndex + 1, Offset - LineStarts[LineIndex] + 1};
+}
 
-  if (LastChar == '&') {
-    NextChar = getc(pFile);
-    if (NextChar == '&') { // AND: &&
-      LastChar = getc(pFile);
-      columnNo += 2;
-      return returnTok("&&", AND);
-    } else {
-      LastChar = NextChar;
-      columnNo++;
-      return returnTok("&", int('&'));
+// Reports Str at Ptr, resolving the line and column only now
+TOKEN Lexer::LogErrorAt(const char *Ptr, std::string Str) {
+  std::pair<unsigned, unsigned> Pos = getLineAndColumn(Ptr);
+  fprintf(stderr, "\nLogError: %u:%u: %s\n\n", Pos.first, Pos.second,
+          Str.c_str());
+  return returnTok(Ptr, INVALID);
+}
+
+// Read the mapped source through CurPtr -- positions are not tracked here,
+// a token's line and column are recovered from its offset when needed
+/// gettok - Return the next token from the source buffer.
+TOKEN Lexer::gettok() {
+  for (;;) {
+    // Skip any whitespace. The single space between tokens is by far the
+    // most common run, so that is stepped over before dispatching to a kernel.
+    if (*CurPtr == ' ')
+      CurPtr++;
+    uint8_t Class = CharClasses[(unsigned char)*CurPtr];
+    if (Class == CC_SPACE || Class == CC_NEWLINE)
+      CurPtr = SkipWhitespace(CurPtr, BufEnd);
+
+    // Check for end of file.  Don't eat the EOF.
+    const char *TokStart = CurPtr;
+    if (CurPtr == BufEnd)
+      return returnTok(TokStart, EOF_TOK);
+
+    // Run the DFA until the next byte has no transition. The '\0' after the
+    // buffer has no transition out of any state but S_START, so this can
+    // never run off the end.
+    uint8_t State = S_START;
+    for (;;) {
+      uint8_t NextState =
+          Transitions[State][CharClasses[(unsigned char)*CurPtr]];
+      if (NextState == S_ERROR)
+        break;
+      State = NextState;
+      CurPtr++;
     }
-  }
 
-  if (LastChar == '|') {
-    NextChar = getc(pFile);
-    if (NextChar == '|') { // OR: ||
-      LastChar = getc(pFile);
-      columnNo += 2;
-      return returnTok("||", OR);
-    } else {
-      LastChar = NextChar;
-      columnNo++;
-      return returnTok("|", int('|'));
+    int tok_type = AcceptTable[State];
+    switch (tok_type) {
+    case TOK_COMMENT:
+      // Skip to the end of the line, the newline itself is whitespace
+      CurPtr = FindLineEnd(CurPtr, BufEnd);
+      continue;
+    case TOK_FIRST_CHAR:
+      return returnTok(TokStart, (unsigned char)*TokStart);
+    case IDENT: {
+      StringRef IdentifierStr(TokStart, CurPtr - TokStart);
+      tok_type = classifyIdentifier(IdentifierStr);
+
+      TOKEN tok = returnTok(TokStart, tok_type);
+      if (tok_type == IDENT)
+        tok.sym = intern(IdentifierStr);
+      else if (tok_type == BOOL_LIT)
+        tok.boolVal = IdentifierStr.front() == 't';
+      return tok;
+    }
+    case INT_LIT:
+      return returnIntTok(TokStart);
+    case FLOAT_LIT:
+      return returnFloatTok(TokStart);
+    default:
+      return returnTok(TokStart, tok_type);
     }
   }
+}
 
-  if (LastChar == '!') {
-    NextChar = getc(pFile);
-    if (NextChar == '=') { // NE: !=
-      LastChar = getc(pFile);
-      columnNo += 2;
-      return returnTok("!=", NE);
-    } else {
-      LastChar = NextChar;
-      columnNo++;
-      return returnTok("!", NOT);
-      ;
-    }
+//===----------------------------------------------------------------------===//
+// Token stream
+//===----------------------------------------------------------------------===//
+
+// TokenStream - the whole file tokenized up front into parallel arrays, one
+// entry per token. Lexemes are kept as an offset and length into BufStart,
+// and Payloads holds the bits of the token's value union. Positions are just
+// the offsets. The stream is a plain value, so it can be kept and walked again
+// without touching the lexer.
+struct TokenStream {
+  const char *BufStart = nullptr; // Start of the buffer that was lexed
+  std::vector<int16_t> Kinds;
+  std::vector<uint32_t> Offsets;
+  std::vector<uint32_t> Lengths;
+  std::vector<uint32_t> Payloads;
+
+  size_t size() const { return Kinds.size(); }
+
+  void push_back(const TOKEN &tok) {
+    Kinds.push_back(tok.type);
+    Offsets.push_back(tok.lexeme.data() - BufStart);
+    Lengths.push_back(tok.lexeme.size());
+    uint32_t payload;
+    memcpy(&payload, &tok.sym, sizeof(payload));
+    Payloads.push_back(payload);
   }
 
-  if (LastChar == '<') {
-    NextChar = getc(pFile);
-    if (NextChar == '=') { // LE: <=
-      LastChar = getc(pFile);
-      columnNo += 2;
-      return returnTok("<=", LE);
-    } else {
-      LastChar = NextChar;
-      columnNo++;
-      return returnTok("<", LT);
+  // Returns the index of the "}" that closes the "{" at Open, or of the final
+  // EOF_TOK if it is never closed
+  size_t findMatchingBrace(size_t Open) const {
+    size_t Depth = 0;
+    for (size_t Index = Open; Index < Kinds.size(); Index++) {
+      if (Kinds[Index] == LBRA) {
+        Depth++;
+      } else if (Kinds[Index] == RBRA && --Depth == 0) {
+        return Index;
+      }
     }
+    return Kinds.size() - 1;
   }
 
-  if (LastChar == '>') {
-    NextChar = getc(pFile);
-    if (NextChar == '=') { // GE: >=
-      LastChar = getc(pFile);
-      columnNo += 2;
-      return returnTok(">=", GE);
-    } else {
-      LastChar = NextChar;
-      columnNo++;
-      return returnTok(">", GT);
+  // Returns the index of the last token of the top-level declaration starting
+  // at Start: its ";", or the "}" closing its body. A declaration that has
+  // neither runs to the final EOF_TOK.
+  size_t findDeclEnd(size_t Start) const {
+    for (size_t Index = Start; Index < Kinds.size(); Index++) {
+      if (Kinds[Index] == SC) {
+        return Index;
+      } else if (Kinds[Index] == LBRA) {
+        return findMatchingBrace(Index);
+      }
     }
+    return Kinds.size() - 1;
   }
 
-  if (LastChar == '/') { // could be division or could be the start of a comment
-    LastChar = getc(pFile);
-    columnNo++;
-    if (LastChar == '/') { // definitely a comment
-      do {
-        LastChar = getc(pFile);
-        columnNo++;
-      } while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
-
-      if (LastChar != EOF)
-        return gettok();
-    } else
-      return returnTok("/", DIV);
+  // Returns the source text from the start of token First to the end of Last
+  StringRef getText(size_t First, size_t Last) const {
+    return StringRef(BufStart + Offsets[First],
+                     Offsets[Last] + Lengths[Last] - Offsets[First]);
   }
 
-  // Check for end of file.  Don't eat the EOF.
-  if (LastChar == EOF) {
-    columnNo++;
-    return returnTok("0", EOF_TOK);
+  // Rebuilds the TOKEN at Index for the parser
+  TOKEN get(size_t Index) const {
+    TOKEN tok;
+    tok.type = Kinds[Index];
+    tok.lexeme = StringRef(BufStart + Offsets[Index], Lengths[Index]);
+    memcpy(&tok.sym, &Payloads[Index], sizeof(tok.sym));
+    return tok;
   }
+};
 
-  // Otherwise, just return the character as its ascii value.
-  int ThisChar = LastChar;
-  std::string s(1, ThisChar);
-  LastChar = getc(pFile);
-  columnNo++;
-  return returnTok(s, int(ThisChar));
+// Lexes the rest of the buffer into a TokenStream. The stream always ends
+// with EOF_TOK.
+TokenStream Lexer::tokenize() {
+  TokenStream Stream;
+  Stream.BufStart = Buf->getBufferStart();
+  // Reserve for a token every few bytes so the arrays rarely regrow
+  size_t Estimate = (BufEnd - CurPtr) / 4 + 1;
+  Stream.Kinds.reserve(Estimate);
+  Stream.Offsets.reserve(Estimate);
+  Stream.Lengths.reserve(Estimate);
+  Stream.Payloads.reserve(Estimate);
+  TOKEN tok;
+  do {
+    tok = gettok();
+    Stream.push_back(tok);
+  } while (tok.type != EOF_TOK);
+  return Stream;
 }
 
 //===----------------------------------------------------------------------===//
-// Parser
+// AST nodes
 //===----------------------------------------------------------------------===//
 
-/// CurTok/getNextToken - Provide a simple token buffer.  CurTok is the current
-/// token the parser is looking at.  getNextToken reads another token from the
-/// lexer and updates CurTok with its results.
-static TOKEN CurTok;
-static std::deque<TOKEN> tok_buffer;
+/// MiniCType - the types of Mini-C values. Void only appears as a return type
+/// and as the type of the placeholder parameter of a "(void)" parameter list.
+enum class MiniCType : uint8_t { Void, Int, Float, Bool };
 
-static TOKEN getNextToken() {
+static const char *typeName(MiniCType Type) {
+  static const char *const Names[] = {"void", "int", "float", "bool"};
+  return Names[static_cast<int>(Type)];
+}
 
-  if (tok_buffer.size() == 0)
-    tok_buffer.push_back(gettok());
+/// BinaryOpcode, UnaryOpcode - the operators of Mini-C, resolved from their
+/// tokens by the parser
+enum class BinaryOpcode : uint8_t {
+  Or, And, Eq, Ne, Le, Lt, Ge, Gt, Add, Sub, Mul, Div, Rem,
+};
 
-  TOKEN temp = tok_buffer.front();
-  tok_buffer.pop_front();
+enum class UnaryOpcode : uint8_t { Neg, Not };
 
-  return CurTok = temp;
+static const char *opSpelling(BinaryOpcode Op) {
+  static const char *const Spellings[] = {"||", "&&", "==", "!=", "<=",
+                                          "<",  ">=", ">",  "+",  "-",
+                                          "*",  "/",  "%"};
+  return Spellings[static_cast<int>(Op)];
 }
 
-static void putBackToken(TOKEN tok) {tok_buffer.push_front(tok);}
-
-// Function to check if a value is a member of an array, used to simplify
-// very long if statements
-static bool CheckMembership(int arr[], int size, int value) {
-  for (int i = 0; i < size; i++) {
-    if (arr[i] == value) {
-      return true;
-    }
-  }
-  return false;
+static const char *opSpelling(UnaryOpcode Op) {
+  return Op == UnaryOpcode::Neg ? "-" : "!";
 }
 
-//===----------------------------------------------------------------------===//
-// AST nodes
-//===----------------------------------------------------------------------===//
-
 /// ASTnode - Base class for all AST nodes.
+///
+/// Nodes live in an ASTContext and are never destroyed one at a time, so no
+/// node has a destructor to run: children are plain pointers and lists are
+/// arrays in the same arena.
+///
+/// Nodes carry no vtable. Each one is tagged with its kind instead, and
+/// codegen on an ASTnode switches over the tag to reach the subclass, in the
+/// style of LLVM's isa<>/cast<>. Other walks over the tree go through
+/// ASTVisitor.
 class ASTnode {
 public:
-  virtual ~ASTnode() {}
-  virtual Value *codegen(int block_index) = 0;
-  virtual std::string to_string(std::string ident_level) const {return nullptr;};
+  enum NodeKind : uint8_t {
+    NK_Int,
+    NK_Float,
+    NK_Bool,
+    NK_Variable,
+    NK_VariableAssignment,
+    NK_VariableDeclaration,
+    NK_Block,
+    NK_Binary,
+    NK_Unary,
+    NK_Cast,
+    NK_Call,
+    NK_FunctionParam,
+    NK_FunctionPrototype,
+    NK_FunctionDef,
+    NK_Extern,
+    NK_IfExpr,
+    NK_WhileExpr,
+    NK_ReturnExpr,
+    NK_Root,
+  };
+
+private:
+  const NodeKind Kind;
+  MiniCType ExprType = MiniCType::Void; // Type of an expression, set by Sema
+
+protected:
+  ASTnode(NodeKind Kind) : Kind(Kind) {}
+
+public:
+  NodeKind getKind() const { return Kind; }
+  MiniCType getExprType() const { return ExprType; }
+  void setExprType(MiniCType Type) { ExprType = Type; }
+  Value *codegen(int block_index);
 };
 
 /// IntASTnode - Class for integer literals like 1, 2, 10
@@ -415,14 +868,10 @@ class IntASTnode : public ASTnode {
   int Val;
 
 public:
-  IntASTnode(int val) : Val(val) {}
-  //virtual Value *codegen() override;
-  virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      oss << ident_level << Val;
-      return oss.str();
-  };
-  Value *codegen(int block_index) override;
+  IntASTnode(int val) : ASTnode(NK_Int), Val(val) {}
+  static bool classof(const ASTnode *N) { return N->getKind() == NK_Int; }
+  int getVal() const { return Val; }
+  Value *codegen(int block_index);
 };
 
 // FloatASTNode - Class for float iterals like 1.5, 2.1, 31.5
@@ -430,13 +879,10 @@ class FloatASTnode : public ASTnode {
   float Val;
 
   public:
-    FloatASTnode(float val) : Val(val) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      oss << ident_level << Val;
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    FloatASTnode(float val) : ASTnode(NK_Float), Val(val) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Float; }
+    float getVal() const { return Val; }
+    Value *codegen(int block_index);
 };
 
 // BoolASTnode - Class for boolean literals true and false 
@@ -444,309 +890,411 @@ class BoolASTnode : public ASTnode {
   bool Val;
 
   public:
-    BoolASTnode(bool val) : Val(val) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      oss << ident_level << Val;
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    BoolASTnode(bool val) : ASTnode(NK_Bool), Val(val) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Bool; }
+    bool getVal() const { return Val; }
+    Value *codegen(int block_index);
 };
 
+// Slot of a variable that is not a local of the function being compiled
+static constexpr uint32_t NonLocalSlot = UINT32_MAX;
+
 // VariableASTnode - Class for referencing a variable like "x"
+
 class VariableASTnode : public ASTnode {
-  std::string Name; // Stores name of variable
+  SymbolID Name; // Stores interned name of variable
+  uint32_t Slot = NonLocalSlot; // Local the name resolves to, set by LocalResolver
 
   public:
-    // Passes in the actual address of the argument name, and we "promise" not to change it with const
-    VariableASTnode(const std::string &name) : Name(name) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      oss << ident_level << Name;
-      return oss.str();
-    }
-    std::string getName() {
+    VariableASTnode(SymbolID name) : ASTnode(NK_Variable), Name(name) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Variable; }
+    SymbolID getName() const {
       return Name;
     }
-    Value *codegen(int block_index) override;
+    uint32_t getSlot() const { return Slot; }
+    void setSlot(uint32_t slot) { Slot = slot; }
+    Value *codegen(int block_index);
 };
 
 // VariableAssignmentASTnode - Class for assigning to a variable like "x = 5"
 class VariableAssignmentASTnode : public ASTnode {
-  std::unique_ptr<VariableASTnode> Variable; // Pointer to variable that is being assigned to
-  std::unique_ptr<ASTnode> Val; // Pointer to ASTnode that is being assigned to variable
+  VariableASTnode *Variable; // Pointer to variable that is being assigned to
+  ASTnode *Val; // Pointer to ASTnode that is being assigned to variable
 
   public:
-    VariableAssignmentASTnode(std::unique_ptr<VariableASTnode> variable, std::unique_ptr<ASTnode> val)
-    : Variable(std::move(variable)), Val(std::move(val)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Assigned identifier \n" << Variable->to_string(child_ident_level) << "\n" << Val->to_string(child_ident_level);
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    VariableAssignmentASTnode(VariableASTnode *variable, ASTnode *val)
+    : ASTnode(NK_VariableAssignment), Variable(variable), Val(val) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_VariableAssignment; }
+    VariableASTnode *getVariable() const { return Variable; }
+    ASTnode *getVal() const { return Val; }
+    void setVal(ASTnode *val) { Val = val; }
+    Value *codegen(int block_index);
 };
 
 // VariableDeclarationASTnode - Class for declaring a variable like "int x"
 class VariableDeclarationASTnode : public ASTnode {
-  std::string Name; // Variable name
-  std::string Type; // Variable type
+  SymbolID Name; // Variable name
+  MiniCType Type; // Variable type
+  uint32_t Slot = NonLocalSlot; // Slot of a local variable, set by LocalResolver
 
   public:
-    VariableDeclarationASTnode(const std::string &name, const std::string &type)
-    : Name(name), Type(type) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      oss << ident_level << "Declared " << Type << " " << Name;
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    VariableDeclarationASTnode(SymbolID name, MiniCType type)
+    : ASTnode(NK_VariableDeclaration), Name(name), Type(type) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_VariableDeclaration; }
+    SymbolID getName() const { return Name; }
+    MiniCType getType() const { return Type; }
+    uint32_t getSlot() const { return Slot; }
+    void setSlot(uint32_t slot) { Slot = slot; }
+    Value *codegen(int block_index);
 };
 
 // BlockASTnode - Class for blocks, represented by curly braces in an if statement for example "if (x) {do something}"
 class BlockASTnode : public ASTnode {
-  std::vector<std::unique_ptr<VariableDeclarationASTnode>> Declarations; //Dynamically allocated array of smart pointers declarations
-  std::vector<std::unique_ptr<ASTnode>>Statements; //Dynamically allocated array of smart pointers to statements
+  ArrayRef<VariableDeclarationASTnode *> Declarations; // Arena array of pointers to declarations
+  ArrayRef<ASTnode *> Statements; // Arena array of pointers to statements
 
   public:
-    BlockASTnode(std::vector<std::unique_ptr<VariableDeclarationASTnode>> declarations, std::vector<std::unique_ptr<ASTnode>> statements)
-    : Declarations(std::move(declarations)), Statements(std::move(statements)) {} 
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Block";
-      for (auto &decl : Declarations) {
-        oss << "\n" << decl->to_string(child_ident_level);
-      }
-      for (auto &stmt : Statements) {
-        oss << "\n" << stmt->to_string(child_ident_level);
-      }
-      return oss.str();
+    BlockASTnode(ArrayRef<VariableDeclarationASTnode *> declarations, ArrayRef<ASTnode *> statements)
+    : ASTnode(NK_Block), Declarations(declarations), Statements(statements) {} 
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Block; }
+    ArrayRef<VariableDeclarationASTnode *> getDeclarations() const { return Declarations; }
+    ArrayRef<ASTnode *> getStatements() const { return Statements; }
+    // The array belongs to this node, so a pass can replace a statement in it
+    // or drop the ones after the first n
+    void setStatement(unsigned index, ASTnode *stmt) {
+      const_cast<ASTnode **>(Statements.data())[index] = stmt;
     }
-    Value *codegen(int block_index) override;
+    void setNumStatements(size_t n) { Statements = Statements.take_front(n); }
+    Value *codegen(int block_index);
 };
 
 // BinaryASTnode - Class for binary operators like + * - /
 class BinaryASTnode : public ASTnode {
-  std::string Op; // Stores what operator this is such as + * - /
-  std::unique_ptr<ASTnode> LHS,RHS; // Smart pointers for AST nodes of left and right operands
+  BinaryOpcode Op; // Stores what operator this is such as + * - /
+  ASTnode *LHS, *RHS; // AST nodes of left and right operands
 
   public:
-    BinaryASTnode(const std::string &op, std::unique_ptr<ASTnode> LHS, std::unique_ptr<ASTnode> RHS)
-    : Op(op), LHS(std::move(LHS)), RHS(std::move(RHS)) {} // Moves memory from arguments to attributes
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Binary operation" << "\n" << LHS->to_string(child_ident_level) << "\n" + child_ident_level << Op << "\n" <<  RHS->to_string(child_ident_level);
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    BinaryASTnode(BinaryOpcode op, ASTnode *LHS, ASTnode *RHS)
+    : ASTnode(NK_Binary), Op(op), LHS(LHS), RHS(RHS) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Binary; }
+    BinaryOpcode getOp() const { return Op; }
+    ASTnode *getLHS() const { return LHS; }
+    ASTnode *getRHS() const { return RHS; }
+    void setLHS(ASTnode *lhs) { LHS = lhs; }
+    void setRHS(ASTnode *rhs) { RHS = rhs; }
+    Value *codegen(int block_index);
 };
 
 // Unary operators - and ! ?
 class UnaryASTnode : public ASTnode {
-  std::string Op; // Stores what operator this is such as ! and ?
-  std::unique_ptr<ASTnode> Val; // Smart pointer for AST nodes of operand
+  UnaryOpcode Op; // Stores what operator this is such as ! and ?
+  ASTnode *Val; // AST node of operand
   public:
-    UnaryASTnode(const std::string &op, std::unique_ptr<ASTnode> val) : Op(op), Val(std::move(val)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Unary operation of " << Op << Val->to_string(child_ident_level);
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    UnaryASTnode(UnaryOpcode op, ASTnode *val) : ASTnode(NK_Unary), Op(op), Val(val) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Unary; }
+    UnaryOpcode getOp() const { return Op; }
+    ASTnode *getOperand() const { return Val; }
+    void setOperand(ASTnode *val) { Val = val; }
+    Value *codegen(int block_index);
+};
+
+// CastASTnode - Class for an implicit conversion, such as of an int operand
+// to float in "x * 0.5", made explicit by Sema
+class CastASTnode : public ASTnode {
+  ASTnode *Val; // AST node of the value converted
+  public:
+    CastASTnode(MiniCType to, ASTnode *val) : ASTnode(NK_Cast), Val(val) {
+      setExprType(to);
+    }
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Cast; }
+    ASTnode *getOperand() const { return Val; }
+    void setOperand(ASTnode *val) { Val = val; }
+    Value *codegen(int block_index);
+    Value *convert(Value *Operand); // Converts the already generated operand
 };
 
 // CallASTnode - Class for function calls such as fib(8)
 class CallASTnode : public ASTnode {
-  std::string CallFunc; //Name of function thats called
-  std::vector<std::unique_ptr<ASTnode>> Args; //Dynamically allocated array of smart pointers to AST objects
+  SymbolID CallFunc; //Interned name of function thats called
+  ArrayRef<ASTnode *> Args; // Arena array of pointers to AST objects
 
   public:
-    CallASTnode(const std::string &callfunc, std::vector<std::unique_ptr<ASTnode>> args)
-    : CallFunc(callfunc), Args(std::move (args)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Calling function " << CallFunc << " with arguments ";
-      for (auto &arg : Args) {
-        oss << "\n" << arg->to_string(child_ident_level);
-      }
-      return oss.str();
+    CallASTnode(SymbolID callfunc, ArrayRef<ASTnode *> args)
+    : ASTnode(NK_Call), CallFunc(callfunc), Args(args) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Call; }
+    SymbolID getCallee() const { return CallFunc; }
+    ArrayRef<ASTnode *> getArgs() const { return Args; }
+    // The array belongs to this node, so Sema can replace an argument in it
+    void setArg(unsigned index, ASTnode *arg) {
+      const_cast<ASTnode **>(Args.data())[index] = arg;
     }
-    Value *codegen(int block_index) override;
+    Value *codegen(int block_index);
 };
 
 // FunctionParamASTnode - Class for function parameters such as "int x"
 class FunctionParamASTnode : public ASTnode {
-  std::string Name;
-  std::string Type;
+  SymbolID Name;
+  MiniCType Type;
 
   public:
-    FunctionParamASTnode(const std::string &name, const std::string &type)
-    : Name(name), Type(type) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      oss << "\n" << ident_level << "Function parameter " << Type << " " << Name;
-      return oss.str();
-    }
-    std::string getName() {
+    FunctionParamASTnode(SymbolID name, MiniCType type)
+    : ASTnode(NK_FunctionParam), Name(name), Type(type) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_FunctionParam; }
+    SymbolID getName() const {
       return Name;
     }
-    std::string getType() {
+    MiniCType getType() const {
       return Type;
     }
-    Value *codegen(int block_index) override;
+    Value *codegen(int block_index);
 };
 
 // FunctionPrototypeASTnode - Class for capturing name, and argument names a function takes like "int function(float x)"
 class FunctionPrototypeASTnode : public ASTnode {
-  std::string Name;
-  std::string Type;
-  std::vector<std::unique_ptr<FunctionParamASTnode>> Args; //Dynamically allocated array of smart pointers to function parameter AST objects
+  SymbolID Name;
+  MiniCType Type;
+  ArrayRef<FunctionParamASTnode *> Args; // Arena array of pointers to function parameter AST objects
 
   public:
-    FunctionPrototypeASTnode(const std::string &name, const std::string &type, std::vector<std::unique_ptr<FunctionParamASTnode>> args)
-    : Name(name), Type(type), Args(std::move(args)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Function Prototype " << Type << " " << Name << " with parameters ";
-      for (auto &arg : Args) {
-        oss << arg->to_string(child_ident_level);
-      }
-      return oss.str();
-    }
-    std::string getName() {
+    FunctionPrototypeASTnode(SymbolID name, MiniCType type, ArrayRef<FunctionParamASTnode *> args)
+    : ASTnode(NK_FunctionPrototype), Name(name), Type(type), Args(args) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_FunctionPrototype; }
+    ArrayRef<FunctionParamASTnode *> getArgs() const { return Args; }
+    SymbolID getName() const {
       return Name;
     }
-    std::string getType() {
+    MiniCType getType() const {
       return Type;
     }
-    std::string getArgType (int index) {
-      std::string arg_type = Args[index]->getType();
-      return arg_type;
+    MiniCType getArgType (int index) const {
+      return Args[index]->getType();
+    }
+    SymbolID getArgName (int index) const {
+      return Args[index]->getName();
     }
-    Function *codegen(int block_index) override;
+    Function *codegen(int block_index);
 };
 
+class Parser;
+
 // FunctionDefASTnode - Class for representing function definitions like "int function(float x) {do something}"
+// A body the parser skipped over (--lazy-bodies) is kept as the token index of its "{" and is
+// only parsed the first time getBody() is called
 class FunctionDefASTnode : public ASTnode {
-  std::unique_ptr<FunctionPrototypeASTnode> Prototype;
-  std::unique_ptr<BlockASTnode> Body;
+  FunctionPrototypeASTnode *Prototype;
+  BlockASTnode *Body; // Null until a lazily parsed body is materialized
+  Parser *BodySource = nullptr; // Parser that skipped the body
+  uint32_t BodyTok = 0; // Token index of the body's "{"
+  uint32_t NumSlots = 0; // Number of parameters and locals, set by Sema
 
   public: 
-    FunctionDefASTnode(std::unique_ptr<FunctionPrototypeASTnode> prototype, std::unique_ptr<BlockASTnode> body)
-    : Prototype(std::move (prototype)), Body(std::move (body)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Function Definition \n" << Prototype->to_string(child_ident_level) << "\n" << Body->to_string(child_ident_level);
-      return oss.str();
-    }
-    Function *codegen(int block_index) override;
+    FunctionDefASTnode(FunctionPrototypeASTnode *prototype, BlockASTnode *body)
+    : ASTnode(NK_FunctionDef), Prototype(prototype), Body(body) {}
+    FunctionDefASTnode(FunctionPrototypeASTnode *prototype, Parser *source, uint32_t bodytok)
+    : ASTnode(NK_FunctionDef), Prototype(prototype), Body(nullptr), BodySource(source), BodyTok(bodytok) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_FunctionDef; }
+    FunctionPrototypeASTnode *getPrototype() const { return Prototype; }
+    bool isBodyParsed() const { return Body != nullptr; }
+    BlockASTnode *getParsedBody() const { return Body; } // Null while lazy
+    uint32_t getBodyTok() const { return BodyTok; }
+    void setBody(BlockASTnode *body) { Body = body; }
+    BlockASTnode *getBody();
+    uint32_t getNumSlots() const { return NumSlots; }
+    void setNumSlots(uint32_t numslots) { NumSlots = numslots; }
+    Function *codegen(int block_index);
 };
 
 // ExternASTnode - Class for representing extern definitions like "extern int print_int(int x)"
 class ExternASTnode: public ASTnode {
-  std::string Name;
-  std::string Type;
-  std::vector<std::unique_ptr<FunctionParamASTnode>> Params;
+  SymbolID Name;
+  MiniCType Type;
+  ArrayRef<FunctionParamASTnode *> Params;
 
   public:
-    ExternASTnode(const std::string &name, const std::string &type, std::vector<std::unique_ptr<FunctionParamASTnode>> params)
-    : Name(name), Type(type), Params(std::move(params)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Extern " << Type << " " << Name << " with parameters";
-      for (auto &param : Params) {
-        oss << param->to_string(child_ident_level);
-      }
-      oss << "\n";
-      return oss.str();
-    }
-    Function *codegen(int block_index) override;
+    ExternASTnode(SymbolID name, MiniCType type, ArrayRef<FunctionParamASTnode *> params)
+    : ASTnode(NK_Extern), Name(name), Type(type), Params(params) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Extern; }
+    SymbolID getName() const { return Name; }
+    MiniCType getType() const { return Type; }
+    ArrayRef<FunctionParamASTnode *> getParams() const { return Params; }
+    Function *codegen(int block_index);
 };
 
 // IfExprASTnode - Class for representing if expressions like "if (x) {do something} else {do something else}"
 class IfExprASTnode : public ASTnode {
-  std::unique_ptr<ASTnode> Cond;
-  std::unique_ptr<BlockASTnode> Then, Else;
+  ASTnode *Cond;
+  BlockASTnode *Then, *Else;
 
   public:
-    IfExprASTnode(std::unique_ptr<ASTnode> Cond, std::unique_ptr<BlockASTnode> Then,
-                  std::unique_ptr<BlockASTnode> Else)
-                  : Cond(std::move(Cond)), Then(std::move(Then)), Else(std::move(Else)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "If \n" << Cond->to_string(child_ident_level) << "\n" << Then->to_string(child_ident_level);
-      if (Else != nullptr) {
-        oss << "\n" << Else->to_string(child_ident_level);
-      }
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    IfExprASTnode(ASTnode *Cond, BlockASTnode *Then,
+                  BlockASTnode *Else)
+                  : ASTnode(NK_IfExpr), Cond(Cond), Then(Then), Else(Else) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_IfExpr; }
+    ASTnode *getCond() const { return Cond; }
+    BlockASTnode *getThen() const { return Then; }
+    BlockASTnode *getElse() const { return Else; }
+    void setCond(ASTnode *cond) { Cond = cond; }
+    Value *codegen(int block_index);
 };
 
 // WhileExprASTnode - Class for representing while expressions like "while (x) {do something}"
 class WhileExprASTnode : public ASTnode {
-  std::unique_ptr<ASTnode> Cond, Then;
+  ASTnode *Cond, *Then;
 
   public:
-    WhileExprASTnode(std::unique_ptr<ASTnode> Cond, std::unique_ptr<ASTnode> Then)
-                    : Cond(std::move(Cond)), Then(std::move(Then)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "While \n" << Cond->to_string(child_ident_level) << "\n" << Then->to_string(child_ident_level);
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    WhileExprASTnode(ASTnode *Cond, ASTnode *Then)
+                    : ASTnode(NK_WhileExpr), Cond(Cond), Then(Then) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_WhileExpr; }
+    ASTnode *getCond() const { return Cond; }
+    ASTnode *getBody() const { return Then; }
+    void setCond(ASTnode *cond) { Cond = cond; }
+    void setBody(ASTnode *body) { Then = body; }
+    Value *codegen(int block_index);
 };
 
 class ReturnExprASTnode : public ASTnode {
-  std::unique_ptr<ASTnode> ReturnValue;
+  ASTnode *ReturnValue;
 
   public:
-    ReturnExprASTnode(std::unique_ptr<ASTnode> returnvalue) : ReturnValue(std::move(returnvalue)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";;
-      oss << ident_level << "Return expression";
-      if (ReturnValue != nullptr) {
-        oss << "\n" << ReturnValue->to_string(child_ident_level);
-      }
-      return oss.str();
-    }
-    Value *codegen(int block_index) override;
+    ReturnExprASTnode(ASTnode *returnvalue) : ASTnode(NK_ReturnExpr), ReturnValue(returnvalue) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_ReturnExpr; }
+    ASTnode *getReturnValue() const { return ReturnValue; }
+    void setReturnValue(ASTnode *returnvalue) { ReturnValue = returnvalue; }
+    Value *codegen(int block_index);
 };
 
 // RootASTnode - Class for representing the root of the AST tree generated while parsing
 // Ties together externs and declarations
 class RootASTnode : public ASTnode {
-  std::vector<std::unique_ptr<ExternASTnode>> Ext_List;
-  std::vector<std::unique_ptr<ASTnode>> Decl_List;
+  ArrayRef<ExternASTnode *> Ext_List;
+  ArrayRef<ASTnode *> Decl_List;
 
   public:
-    RootASTnode(std::vector<std::unique_ptr<ExternASTnode>> ext_list, std::vector<std::unique_ptr<ASTnode>> decl_list)
-    : Ext_List(std::move(ext_list)), Decl_List(std::move(decl_list)) {}
-    virtual std::string to_string(std::string ident_level) const override {
-      std::ostringstream oss;
-      std::string child_ident_level = ident_level + " |-";
-      oss << ident_level << "Program root \n";
-      for (auto &ext : Ext_List) {
-        oss << ext->to_string(child_ident_level);
-      }
-      for (auto &decl : Decl_List) {
-        oss << decl->to_string(child_ident_level);
-      }
-      return oss.str();
+    RootASTnode(ArrayRef<ExternASTnode *> ext_list, ArrayRef<ASTnode *> decl_list)
+    : ASTnode(NK_Root), Ext_List(ext_list), Decl_List(decl_list) {}
+    static bool classof(const ASTnode *N) { return N->getKind() == NK_Root; }
+    ArrayRef<ExternASTnode *> getExterns() const { return Ext_List; }
+    ArrayRef<ASTnode *> getDecls() const { return Decl_List; }
+    void setExterns(ArrayRef<ExternASTnode *> ext_list) { Ext_List = ext_list; }
+    void setDecls(ArrayRef<ASTnode *> decl_list) { Decl_List = decl_list; }
+    Value *codegen(int block_index);
+};
+
+/// ASTVisitor - calls the visit method of Derived that matches the kind of a
+/// node, in the style of llvm::InstVisitor. Derived classes define the visit
+/// methods for the kinds they care about; the rest do nothing.
+template <typename Derived, typename RetTy = void> class ASTVisitor {
+public:
+  RetTy visit(ASTnode *N) {
+    Derived *D = static_cast<Derived *>(this);
+    switch (N->getKind()) {
+    case ASTnode::NK_Int:
+      return D->visitInt(cast<IntASTnode>(N));
+    case ASTnode::NK_Float:
+      return D->visitFloat(cast<FloatASTnode>(N));
+    case ASTnode::NK_Bool:
+      return D->visitBool(cast<BoolASTnode>(N));
+    case ASTnode::NK_Variable:
+      return D->visitVariable(cast<VariableASTnode>(N));
+    case ASTnode::NK_VariableAssignment:
+      return D->visitVariableAssignment(cast<VariableAssignmentASTnode>(N));
+    case ASTnode::NK_VariableDeclaration:
+      return D->visitVariableDeclaration(cast<VariableDeclarationASTnode>(N));
+    case ASTnode::NK_Block:
+      return D->visitBlock(cast<BlockASTnode>(N));
+    case ASTnode::NK_Binary:
+      return D->visitBinary(cast<BinaryASTnode>(N));
+    case ASTnode::NK_Unary:
+      return D->visitUnary(cast<UnaryASTnode>(N));
+    case ASTnode::NK_Cast:
+      return D->visitCast(cast<CastASTnode>(N));
+    case ASTnode::NK_Call:
+      return D->visitCall(cast<CallASTnode>(N));
+    case ASTnode::NK_FunctionParam:
+      return D->visitFunctionParam(cast<FunctionParamASTnode>(N));
+    case ASTnode::NK_FunctionPrototype:
+      return D->visitFunctionPrototype(cast<FunctionPrototypeASTnode>(N));
+    case ASTnode::NK_FunctionDef:
+      return D->visitFunctionDef(cast<FunctionDefASTnode>(N));
+    case ASTnode::NK_Extern:
+      return D->visitExtern(cast<ExternASTnode>(N));
+    case ASTnode::NK_IfExpr:
+      return D->visitIfExpr(cast<IfExprASTnode>(N));
+    case ASTnode::NK_WhileExpr:
+      return D->visitWhileExpr(cast<WhileExprASTnode>(N));
+    case ASTnode::NK_ReturnExpr:
+      return D->visitReturnExpr(cast<ReturnExprASTnode>(N));
+    case ASTnode::NK_Root:
+      return D->visitRoot(cast<RootASTnode>(N));
     }
-    Value *codegen(int block_index) override;
+    llvm_unreachable("unknown AST node kind");
+  }
+
+  RetTy visitInt(IntASTnode *N) { return RetTy(); }
+  RetTy visitFloat(FloatASTnode *N) { return RetTy(); }
+  RetTy visitBool(BoolASTnode *N) { return RetTy(); }
+  RetTy visitVariable(VariableASTnode *N) { return RetTy(); }
+  RetTy visitVariableAssignment(VariableAssignmentASTnode *N) { return RetTy(); }
+  RetTy visitVariableDeclaration(VariableDeclarationASTnode *N) { return RetTy(); }
+  RetTy visitBlock(BlockASTnode *N) { return RetTy(); }
+  RetTy visitBinary(BinaryASTnode *N) { return RetTy(); }
+  RetTy visitUnary(UnaryASTnode *N) { return RetTy(); }
+  RetTy visitCast(CastASTnode *N) { return RetTy(); }
+  RetTy visitCall(CallASTnode *N) { return RetTy(); }
+  RetTy visitFunctionParam(FunctionParamASTnode *N) { return RetTy(); }
+  RetTy visitFunctionPrototype(FunctionPrototypeASTnode *N) { return RetTy(); }
+  RetTy visitFunctionDef(FunctionDefASTnode *N) { return RetTy(); }
+  RetTy visitExtern(ExternASTnode *N) { return RetTy(); }
+  RetTy visitIfExpr(IfExprASTnode *N) { return RetTy(); }
+  RetTy visitWhileExpr(WhileExprASTnode *N) { return RetTy(); }
+  RetTy visitReturnExpr(ReturnExprASTnode *N) { return RetTy(); }
+  RetTy visitRoot(RootASTnode *N) { return RetTy(); }
+};
+
+/// ASTContext - owns every AST node of one translation unit. Nodes and their
+/// child arrays are bump allocated out of large slabs, so building the tree
+/// costs a pointer increment per node and the whole tree is freed slab by slab
+/// when the context goes away, without visiting a single node.
+class ASTContext {
+  BumpPtrAllocator Allocator;
+  // Arenas of parsers running on other threads, freed along with this one
+  std::vector<std::unique_ptr<ASTContext>> WorkerContexts;
+  // A loaded AST cache file, which holds the nodes in place of the arena
+  std::unique_ptr<sys::fs::mapped_file_region> Mapping;
+
+public:
+  template <typename T, typename... ArgTs> T *create(ArgTs &&...Args) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "AST nodes are freed without running their destructors");
+    return new (Allocator.Allocate<T>()) T(std::forward<ArgTs>(Args)...);
+  }
+
+  // Copies a list the parser built up into the arena
+  template <typename T> ArrayRef<T> copyArray(const std::vector<T> &Elems) {
+    if (Elems.empty())
+      return ArrayRef<T>();
+    T *Mem = Allocator.Allocate<T>(Elems.size());
+    std::uninitialized_copy(Elems.begin(), Elems.end(), Mem);
+    return ArrayRef<T>(Mem, Elems.size());
+  }
+
+  void adoptMapping(std::unique_ptr<sys::fs::mapped_file_region> Region) {
+    Mapping = std::move(Region);
+  }
+
+  // Adds an arena for one worker thread. Only call this from the thread that
+  // owns the context, before the workers start.
+  ASTContext &createWorkerContext() {
+    WorkerContexts.push_back(std::make_unique<ASTContext>());
+    return *WorkerContexts.back();
+  }
+
+  size_t getBytesAllocated() const {
+    size_t Bytes = Allocator.getBytesAllocated();
+    for (const auto &Worker : WorkerContexts)
+      Bytes += Worker->getBytesAllocated();
+    return Bytes;
+  }
 };
 
 //===----------------------------------------------------------------------===//
@@ -754,401 +1302,695 @@ class RootASTnode : public ASTnode {
 //===----------------------------------------------------------------------===//
 
 // Helper functions for error handling - taken from llvm tutorial
-std::unique_ptr<ASTnode> LogError(std::string Str) {
+ASTnode *LogError(std::string Str) {
   fprintf(stderr, "\nLogError: %s\n\n", Str.c_str());
   return nullptr;
 }
-std::unique_ptr<FunctionPrototypeASTnode> LogErrorP(std::string Str) {
+FunctionPrototypeASTnode *LogErrorP(std::string Str) {
   LogError(Str);
   return nullptr;
 }
 
-// Function declarations
-static std::unique_ptr<RootASTnode> ParseProgram();
-static std::vector<std::unique_ptr<ExternASTnode>> ParseExternList();
-static std::vector<std::unique_ptr<ASTnode>> ParseDeclList();
-static std::unique_ptr<ExternASTnode> ParseExtern();
-static std::vector<std::unique_ptr<ExternASTnode>> ParseExternListPrime(std::vector<std::unique_ptr<ExternASTnode>> ext_list);
-static std::string ParseTypeSpec();
-static std::vector<std::unique_ptr<FunctionParamASTnode>> ParseParams();
-static std::string ParseVarType();
-static std::vector<std::unique_ptr<FunctionParamASTnode>> ParseParamList();
-static std::unique_ptr<FunctionParamASTnode> ParseParam();
-static std::vector<std::unique_ptr<FunctionParamASTnode>> ParseParamListPrime(std::vector<std::unique_ptr<FunctionParamASTnode>> params);
-static std::unique_ptr<ASTnode> ParseDecl();
-static std::vector<std::unique_ptr<ASTnode>> ParseDeclListPrime(std::vector<std::unique_ptr<ASTnode>> decl_list);
-static std::unique_ptr<FunctionDefASTnode> ParseVoidFunDecl();
-static std::unique_ptr<ASTnode> ParseTypeNameDecl();
-static std::unique_ptr<BlockASTnode> ParseBlock();
-static std::unique_ptr<FunctionDefASTnode> ParseVarFunDecl(std::string type, std::string identifier);
-static std::vector<std::unique_ptr<VariableDeclarationASTnode>> ParseLocalDecls();
-static std::vector<std::unique_ptr<ASTnode>> ParseStmtList();
-static std::unique_ptr<VariableDeclarationASTnode> ParseLocalDecl();
-static std::vector<std::unique_ptr<VariableDeclarationASTnode>> ParseLocalDeclsPrime(std::vector<std::unique_ptr<VariableDeclarationASTnode>> declarations);
-static std::unique_ptr<ASTnode> ParseStmt();
-static std::vector<std::unique_ptr<ASTnode>> ParseStmtListPrime(std::vector<std::unique_ptr<ASTnode>> stmt_list);
-static std::unique_ptr<ASTnode> ParseExprStmt();
-static std::unique_ptr<IfExprASTnode> ParseIf();
-static std::unique_ptr<WhileExprASTnode> ParseWhile();
-static std::unique_ptr<ReturnExprASTnode> ParseReturn();
-static std::unique_ptr<ASTnode> ParseExpr();
-static std::unique_ptr<ASTnode> ParseRval();
-static std::unique_ptr<BlockASTnode> ParseElse();
-static std::unique_ptr<ASTnode> ParseRvalOne();
-static std::unique_ptr<BinaryASTnode>  ParseRvalPrime(std::unique_ptr<ASTnode> lhs);
-static std::unique_ptr<ASTnode> ParseRvalTwo();
-static std::unique_ptr<BinaryASTnode> ParseRvalOnePrime(std::unique_ptr<ASTnode> lhs);
-static std::unique_ptr<ASTnode> ParseRvalThree();
-static std::unique_ptr<BinaryASTnode> ParseRvalTwoPrime(std::unique_ptr<ASTnode> lhs);
-static std::unique_ptr<ASTnode> ParseRvalFour();
-static std::unique_ptr<BinaryASTnode> ParseRvalThreePrime(std::unique_ptr<ASTnode> lhs);
-static std::unique_ptr<ASTnode> ParseRvalFive();
-static std::unique_ptr<BinaryASTnode> ParseRvalFourPrime(std::unique_ptr<ASTnode> lhs);
-static std::unique_ptr<ASTnode> ParseRvalSix();
-static std::unique_ptr<BinaryASTnode> ParseRvalFivePrime(std::unique_ptr<ASTnode> lhs);
-static std::unique_ptr<ASTnode> ParseRvalSeven();
-static std::unique_ptr<ASTnode> ParseRvalEight();
-static std::unique_ptr<ASTnode> ParseRvalNine();
-static std::vector<std::unique_ptr<ASTnode>> ParseArgs();
-static std::vector<std::unique_ptr<ASTnode>> ParseArgList();
-static std::vector<std::unique_ptr<ASTnode>> ParseArgListPrime(std::vector<std::unique_ptr<ASTnode>> args);
+/// Parser - a recursive descent parser over the tokens of one Lexer. CurTok
+/// is the current token the parser is looking at. getNextToken reads another
+/// token and updates CurTok with its results.
+///
+/// When the file has been pre-tokenized (the default), tokens come from
+/// Tokens at TokIndex and putting a token back just steps the index back.
+/// Otherwise they are pulled from the lexer one at a time through tok_buffer.
+///
+/// With LazyBodies, the body of each function definition is only brace
+/// matched while the program is parsed. parseLazyBody parses it later, so the
+/// Parser has to outlive any use of the tree. This needs the token stream, so
+/// it is ignored when streaming tokens.
+///
+/// With ParseThreads > 1 and no LazyBodies, the top level is parsed the same
+/// way and the skipped bodies are then parsed in parallel by worker Parsers,
+/// each with its own arena, reading this Parser's token stream. On a syntax
+/// error the program is parsed serially instead, so errors are reported
+/// exactly as without threads.
+class Parser {
+  Lexer &Lex;
+  ASTContext &Ctx;
+  TOKEN CurTok;
+  bool PreTokenize;
+  bool LazyBodies;
+  unsigned ParseThreads = 1;
+  bool Quiet = false; // Workers leave reporting errors to the main parser
+  TokenStream Tokens;
+  const TokenStream *Stream = &Tokens; // A worker reads its parent's Tokens
+  size_t TokIndex = 0;
+  std::deque<TOKEN> tok_buffer;
+  // Top-level declarations of an earlier parse of this file, by the hash of
+  // their text, and the hash of each declaration parsed here
+  std::unordered_map<uint64_t, ASTnode *> Reusable;
+  std::vector<uint64_t> DeclHashes;
+
+  TOKEN getNextToken();
+  void putBackToken(TOKEN tok);
+  ASTnode *LogErrorAt(const TOKEN &Tok, std::string Str);
+
+  RootASTnode *ParseProgram();
+  std::vector<ExternASTnode *> ParseExternList();
+  std::vector<ASTnode *> ParseDeclList();
+  ExternASTnode *ParseExtern();
+  void ParseExternListPrime(std::vector<ExternASTnode *> &ext_list);
+  MiniCType ParseTypeSpec();
+  std::vector<FunctionParamASTnode *> ParseParams();
+  MiniCType ParseVarType();
+  std::vector<FunctionParamASTnode *> ParseParamList();
+  FunctionParamASTnode *ParseParam();
+  void ParseParamListPrime(std::vector<FunctionParamASTnode *> &params);
+  ASTnode *ParseDecl();
+  void ParseDeclListPrime(std::vector<ASTnode *> &decl_list);
+  FunctionDefASTnode *ParseVoidFunDecl();
+  ASTnode *ParseTypeNameDecl();
+  BlockASTnode *ParseBlock();
+  FunctionDefASTnode *ParseFunctionBody(FunctionPrototypeASTnode *proto);
+  void parseBodiesInParallel(RootASTnode *root);
+  template <typename T> T *ParseReusable(T *(Parser::*Parse)());
+
+  // A worker that parses bodies out of Parent's token stream into Ctx
+  Parser(const Parser &Parent, ASTContext &Ctx)
+      : Lex(Parent.Lex), Ctx(Ctx), PreTokenize(true), LazyBodies(false),
+        Quiet(true), Stream(&Parent.Tokens) {}
+  FunctionDefASTnode *ParseVarFunDecl(MiniCType type, SymbolID identifier);
+  std::vector<VariableDeclarationASTnode *> ParseLocalDecls();
+  std::vector<ASTnode *> ParseStmtList();
+  VariableDeclarationASTnode *ParseLocalDecl();
+  void ParseLocalDeclsPrime(std::vector<VariableDeclarationASTnode *> &declarations);
+  ASTnode *ParseStmt();
+  void ParseStmtListPrime(std::vector<ASTnode *> &stmt_list);
+  ASTnode *ParseExprStmt();
+  IfExprASTnode *ParseIf();
+  WhileExprASTnode *ParseWhile();
+  ReturnExprASTnode *ParseReturn();
+  ASTnode *ParseExpr();
+  ASTnode *ParseRval();
+  BlockASTnode *ParseElse();
+  ASTnode *ParseBinOpRHS(int min_prec, ASTnode *lhs);
+  ASTnode *ParseRvalSix();
+  ASTnode *ParseRvalSeven();
+  ASTnode *ParseRvalEight();
+  ASTnode *ParseRvalNine();
+  std::vector<ASTnode *> ParseArgs();
+  std::vector<ASTnode *> ParseArgList();
+  void ParseArgListPrime(std::vector<ASTnode *> &args);
+
+public:
+  Parser(Lexer &Lex, ASTContext &Ctx, bool PreTokenize = true,
+         bool LazyBodies = false, unsigned ParseThreads = 1)
+      : Lex(Lex), Ctx(Ctx), PreTokenize(PreTokenize),
+        LazyBodies(LazyBodies && PreTokenize),
+        ParseThreads(PreTokenize ? ParseThreads : 1) {}
+
+  RootASTnode *parse();
+  BlockASTnode *parseLazyBody(uint32_t BodyTok);
+  void reuseDecls(RootASTnode *Previous, ArrayRef<uint64_t> Hashes);
+  // Hashes of the text of each extern, then each declaration, of the parsed
+  // program. Empty when the parser streamed its tokens.
+  ArrayRef<uint64_t> getDeclHashes() const { return DeclHashes; }
+};
+
+TOKEN Parser::getNextToken() {
+  if (PreTokenize) {
+    // Reading past the end keeps returning the final EOF_TOK
+    size_t Index = std::min(TokIndex++, Stream->size() - 1);
+    return CurTok = Stream->get(Index);
+  }
+
+  if (tok_buffer.size() == 0)
+    tok_buffer.push_back(Lex.gettok());
+
+  TOKEN temp = tok_buffer.front();
+  tok_buffer.pop_front();
+
+  return CurTok = temp;
+}
+
+// Only ever called with the token getNextToken() just returned
+void Parser::putBackToken(TOKEN tok) {
+  if (PreTokenize) {
+    TokIndex--;
+    return;
+  }
+  tok_buffer.push_front(tok);
+}
+
+// Reports Str at Tok's position, resolving the line and column only now
+ASTnode *Parser::LogErrorAt(const TOKEN &Tok, std::string Str) {
+  if (!Quiet)
+    Lex.LogErrorAt(Tok.lexeme.data(), Str);
+  return nullptr;
+}
+
+// Token types are sparse -- negative codes for multi-character tokens, the
+// ascii value for single characters -- so each kind the parser names is given
+// a dense index here. Index 0 stands for every other type, INVALID and stray
+// characters included, and is in no set.
+static constexpr int TokenKinds[] = {
+    EOF_TOK,  IDENT,     ASSIGN,   LBRA,    RBRA,   LPAR,     RPAR,
+    SC,       COMMA,     INT_TOK,  VOID_TOK, FLOAT_TOK, BOOL_TOK, EXTERN,
+    IF,       ELSE,      WHILE,    RETURN,  INT_LIT, FLOAT_LIT, BOOL_LIT,
+    AND,      OR,        PLUS,     MINUS,   ASTERIX, DIV,      MOD,
+    NOT,      EQ,        NE,       LE,      LT,     GE,       GT,
+};
+
+static constexpr unsigned NumTokenKinds = std::size(TokenKinds) + 1;
+static_assert(NumTokenKinds <= 64, "token kinds no longer fit in a TokenSet");
+
+// The lexer only produces types in [INVALID, 255], the top being a stray
+// non-ascii byte, so the table is indexed by type - INVALID
+static constexpr int MaxTokenType = 255;
+
+static constexpr std::array<uint8_t, MaxTokenType - INVALID + 1>
+buildTokenKindTable() {
+  std::array<uint8_t, MaxTokenType - INVALID + 1> Table{};
+  for (unsigned Kind = 1; Kind < NumTokenKinds; Kind++)
+    Table[TokenKinds[Kind - 1] - INVALID] = Kind;
+  return Table;
+}
+
+static constexpr std::array<uint8_t, MaxTokenType - INVALID + 1>
+    TokenKindTable = buildTokenKindTable();
+
+// Returns the dense index of a token type
+static constexpr unsigned tokenKind(int tok_type) {
+  unsigned Index = tok_type - INVALID;
+  return Index < TokenKindTable.size() ? TokenKindTable[Index] : 0;
+}
+
+// A set of token kinds, one bit per kind, so a membership test is a table
+// load and a shift
+class TokenSet {
+  uint64_t Bits = 0;
+
+  constexpr explicit TokenSet(uint64_t Bits) : Bits(Bits) {}
+
+public:
+  constexpr TokenSet(std::initializer_list<int> Toks) {
+    for (int Tok : Toks)
+      Bits |= uint64_t(1) << tokenKind(Tok);
+  }
+
+  constexpr TokenSet operator|(TokenSet Other) const {
+    return TokenSet(Bits | Other.Bits);
+  }
+
+  constexpr bool contains(int tok_type) const {
+    return (Bits >> tokenKind(tok_type)) & 1;
+  }
+};
+
+// FIRST and FOLLOW sets of grammar.bnf that the parser branches on
+// FIRST(var_type), also FIRST(local_decl) and FIRST(param)
+static constexpr TokenSet FirstVarType = {INT_TOK, FLOAT_TOK, BOOL_TOK};
+// FIRST(decl), also FOLLOW(extern_list_prime)
+static constexpr TokenSet FirstDecl = FirstVarType | TokenSet{VOID_TOK};
+// FIRST(expr), also FIRST(args)
+static constexpr TokenSet FirstExpr = {LPAR,    MINUS,     NOT,     IDENT,
+                                       INT_LIT, FLOAT_LIT, BOOL_LIT};
+// FIRST(expr_stmt)
+static constexpr TokenSet FirstExprStmt = FirstExpr | TokenSet{SC};
+// FIRST(stmt), also FOLLOW(local_decls_prime)
+static constexpr TokenSet FirstStmt =
+    FirstExprStmt | TokenSet{WHILE, IF, RETURN, LBRA};
+// FOLLOW(else_stmt)
+static constexpr TokenSet FollowElseStmt = FirstStmt | TokenSet{RBRA};
+// FOLLOW(rval)
+static constexpr TokenSet FollowRval = {SC, RPAR, COMMA};
+
+// Binary operators and their precedence, following the rval_* levels of
+// grammar.bnf: rval_prime binds loosest and rval_five_prime tightest
+struct BinaryOp {
+  int Tok;
+  int Prec;
+  BinaryOpcode Opcode;
+};
+
+static constexpr BinaryOp BinaryOps[] = {
+    {OR, 1, BinaryOpcode::Or},
+    {AND, 2, BinaryOpcode::And},
+    {EQ, 3, BinaryOpcode::Eq},      {NE, 3, BinaryOpcode::Ne},
+    {LE, 4, BinaryOpcode::Le},      {LT, 4, BinaryOpcode::Lt},
+    {GE, 4, BinaryOpcode::Ge},      {GT, 4, BinaryOpcode::Gt},
+    {PLUS, 5, BinaryOpcode::Add},   {MINUS, 5, BinaryOpcode::Sub},
+    {ASTERIX, 6, BinaryOpcode::Mul}, {DIV, 6, BinaryOpcode::Div},
+    {MOD, 6, BinaryOpcode::Rem},
+};
+
+static constexpr std::array<uint8_t, NumTokenKinds> buildPrecedenceTable() {
+  std::array<uint8_t, NumTokenKinds> Table{};
+  for (const BinaryOp &Op : BinaryOps)
+    Table[tokenKind(Op.Tok)] = Op.Prec;
+  return Table;
+}
+
+static constexpr std::array<uint8_t, NumTokenKinds> PrecedenceTable =
+    buildPrecedenceTable();
+
+// Returns the precedence of a binary operator token, or 0 for any other token
+static int binaryPrecedence(int tok_type) {
+  return PrecedenceTable[tokenKind(tok_type)];
+}
+
+static constexpr std::array<BinaryOpcode, NumTokenKinds> buildOpcodeTable() {
+  std::array<BinaryOpcode, NumTokenKinds> Table{};
+  for (const BinaryOp &Op : BinaryOps)
+    Table[tokenKind(Op.Tok)] = Op.Opcode;
+  return Table;
+}
+
+static constexpr std::array<BinaryOpcode, NumTokenKinds> OpcodeTable =
+    buildOpcodeTable();
+
+// Returns the opcode of a binary operator token
+static BinaryOpcode binaryOpcode(int tok_type) {
+  return OpcodeTable[tokenKind(tok_type)];
+}
+
 
 // program_prime ::= program eof
-static std::unique_ptr<RootASTnode> parser() {
+RootASTnode *Parser::parse() {
   // Root of the parser and AST tree, prepares first token, creates root ast node, and calls first production
+  if (PreTokenize) {
+    Tokens = Lex.tokenize();
+    TokIndex = 0;
+  }
   CurTok = getNextToken();
-  std::unique_ptr<RootASTnode> program;
+  RootASTnode *program;
   if (CurTok.type != EOF_TOK){
+    if (ParseThreads > 1 && !LazyBodies) {
+      // Split the program at function bodies, then parse them all at once
+      LazyBodies = true;
+      Quiet = true;
+      try {
+        program = ParseProgram();
+      } catch (...) {
+        program = nullptr;
+      }
+      LazyBodies = false;
+      Quiet = false;
+      if (program != nullptr) {
+        parseBodiesInParallel(program);
+        return program;
+      }
+      // A skipped body may hold an error before the one at the top level, so
+      // the program is parsed again serially to report the first one
+      TokIndex = 0;
+      DeclHashes.clear();
+      CurTok = getNextToken();
+    }
     program = ParseProgram();
-    return std::move(program);
+    return program;
   }
   return nullptr;
 }
 
+// Parses every skipped function body on ParseThreads workers. Each worker
+// claims the next unparsed function in source order, so the tree comes out
+// the same as a serial parse. A worker that hits a syntax error stops quietly;
+// the first failing body in source order is then parsed again here, which
+// reports the error exactly as the serial parser would have.
+void Parser::parseBodiesInParallel(RootASTnode *root) {
+  std::vector<FunctionDefASTnode *> funcs;
+  for (ASTnode *decl : root->getDecls()) {
+    auto *func = dyn_cast<FunctionDefASTnode>(decl);
+    if (func != nullptr && !func->isBodyParsed()) {
+      funcs.push_back(func);
+    }
+  }
+  unsigned num_workers = std::min<size_t>(ParseThreads, funcs.size());
+  std::atomic<size_t> next_func(0);
+  std::atomic<size_t> first_error(funcs.size());
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < num_workers; i++) {
+    workers.emplace_back([&, &worker_ctx = Ctx.createWorkerContext()] {
+      Parser worker(*this, worker_ctx);
+      size_t index;
+      while ((index = next_func++) < funcs.size()) {
+        try {
+          funcs[index]->setBody(worker.parseLazyBody(funcs[index]->getBodyTok()));
+        } catch (...) {
+          size_t seen = first_error;
+          while (index < seen && !first_error.compare_exchange_weak(seen, index)) {
+          }
+        }
+      }
+    });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  if (first_error < funcs.size()) {
+    parseLazyBody(funcs[first_error]->getBodyTok());
+  }
+}
+
+// Makes the top-level declarations of Previous, the tree of an earlier version
+// of this file, available to parse(). Hashes is that tree's getDeclHashes().
+void Parser::reuseDecls(RootASTnode *Previous, ArrayRef<uint64_t> Hashes) {
+  if (Hashes.size() != Previous->getExterns().size() + Previous->getDecls().size()) {
+    return;
+  }
+  const uint64_t *hash = Hashes.begin();
+  for (ExternASTnode *ext : Previous->getExterns()) {
+    Reusable.emplace(*hash++, ext);
+  }
+  for (ASTnode *decl : Previous->getDecls()) {
+    Reusable.emplace(*hash++, decl);
+  }
+}
+
+// Parses one top-level declaration with Parse and records the hash of its
+// text. If an earlier parse had a declaration with the same text, its tree is
+// returned instead and the tokens are skipped. Identical text always parses to
+// an identical tree, since top-level declarations do not depend on each other.
+template <typename T> T *Parser::ParseReusable(T *(Parser::*Parse)()) {
+  if (!PreTokenize) {
+    return (this->*Parse)();
+  }
+  size_t first = TokIndex - 1; // CurTok
+  if (!Reusable.empty()) {
+    size_t last = Stream->findDeclEnd(first);
+    auto entry = Reusable.find(xxHash64(Stream->getText(first, last)));
+    if (entry != Reusable.end() && isa<T>(entry->second)) {
+      T *decl = cast<T>(entry->second);
+      DeclHashes.push_back(entry->first);
+      // A second copy of the same text gets a tree of its own
+      Reusable.erase(entry);
+      TokIndex = last + 1;
+      CurTok = getNextToken();
+      return decl;
+    }
+  }
+  T *decl = (this->*Parse)();
+  DeclHashes.push_back(xxHash64(Stream->getText(first, TokIndex - 2)));
+  return decl;
+}
+
 // program ::= extern_list decl_list
 //          | decl_list
-static std::unique_ptr<RootASTnode> ParseProgram() {
+RootASTnode *Parser::ParseProgram() {
   // Creates dynamically allocated arrays for both externs and declarations
-  std::vector<std::unique_ptr<ExternASTnode>> ext_list;
-  std::vector<std::unique_ptr<ASTnode>> decl_list;
+  std::vector<ExternASTnode *> ext_list;
+  std::vector<ASTnode *> decl_list;
   // Checks if current token is in FIRST set of extern_list or decl_list
   // Calls appropriate procedures for productions
   if (CurTok.type == EXTERN) {
     ext_list = ParseExternList();
     decl_list = ParseDeclList();
-  } else if (CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK || CurTok.type == VOID_TOK) {
+  } else if (FirstDecl.contains(CurTok.type)) {
     decl_list = ParseDeclList();
   } else {
-    throw LogError("Syntax Error: Expected extern for extern or type int, float, bool, or void");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected extern for extern or type int, float, bool, or void");
   }
   // Creates root AST node and returns
-  std::unique_ptr<RootASTnode> root = std::make_unique<RootASTnode>(std::move(ext_list), std::move(decl_list));
-  return std::move(root);
+  RootASTnode *root = Ctx.create<RootASTnode>(Ctx.copyArray(ext_list), Ctx.copyArray(decl_list));
+  return root;
 }
 
 // extern_list ::= extern extern_list_prime
-static std::vector<std::unique_ptr<ExternASTnode>> ParseExternList() {
+std::vector<ExternASTnode *> Parser::ParseExternList() {
   // Creates AST node for first extern and dynamically allocated array of AST nodes for next externs
-  std::unique_ptr<ExternASTnode> ext;
-  std::vector<std::unique_ptr<ExternASTnode>> ext_list;
+  ExternASTnode *ext;
+  std::vector<ExternASTnode *> ext_list;
   // Calls procedures corresponding to production in order
-  ext = ParseExtern();
+  ext = ParseReusable(&Parser::ParseExtern);
   // After receiving first extern, moves it to front of extern list
-  ext_list.push_back(std::move(ext));
+  ext_list.push_back(ext);
   // Extern list with first extern is passed to production which generates further externs
-  ext_list = ParseExternListPrime(std::move(ext_list));
-  return(std::move(ext_list));
+  ParseExternListPrime(ext_list);
+  return(ext_list);
 }
 
 // extern_list_prime ::= extern extern_list_prime
 //                    | epsilon
-static std::vector<std::unique_ptr<ExternASTnode>> ParseExternListPrime(std::vector<std::unique_ptr<ExternASTnode>> ext_list) {
-  // Checks if next token is extern or if in the follow set of extern_list_prime, otherwise, throws error
-  if (CurTok.type == EXTERN) {
+void Parser::ParseExternListPrime(std::vector<ExternASTnode *> &ext_list) {
+  // The tail recursion of the production is run as a loop, each extern is
+  // pushed onto the end of ext_list in place
+  while (CurTok.type == EXTERN) {
     // Creates AST node for new extern and assigns to it by calling ParseExtern production
-    std::unique_ptr<ExternASTnode> ext;
-    ext = ParseExtern();
+    ExternASTnode *ext;
+    ext = ParseReusable(&Parser::ParseExtern);
     // Pushes new extern onto end of extern list
-    ext_list.push_back(std::move(ext));
-    // Extern list passed to production recursively to generate further externs
-    ext_list = ParseExternListPrime(std::move(ext_list));
-    return std::move(ext_list);
-  } else if (CurTok.type == VOID_TOK || CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK) {
-    // Current token is in the FOLLOW set of extern_list_prime, so we return and stop generating externs here
-    return std::move(ext_list); 
-  } else {
-    throw LogError("Syntax Error: Expected an extern or declaration after extern");
+    ext_list.push_back(ext);
   }
+  // Checks if next token is in the follow set of extern_list_prime, otherwise, throws error
+  if (!FirstDecl.contains(CurTok.type)) {
+    throw LogErrorAt(CurTok, "Syntax Error: Expected an extern or declaration after extern");
+  }
+  // Current token is in the FOLLOW set of extern_list_prime, so we stop generating externs here
 }
 
 // extern ::= "extern" type_spec IDENT "(" params ")" ";"
-static std::unique_ptr<ExternASTnode> ParseExtern() {
+ExternASTnode *Parser::ParseExtern() {
   // Creates variables to hold type and identifier of extern
   CurTok = getNextToken(); // eat extern
-  std::string type = ParseTypeSpec();
-  std::string identifier;
+  MiniCType type = ParseTypeSpec();
+  SymbolID identifier;
   if (CurTok.type == IDENT){
-    identifier = CurTok.lexeme;
+    identifier = CurTok.sym;
     CurTok = getNextToken(); // eat IDENT
   } else {
-    throw LogError("Syntax Error: Expected identifier after type");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected identifier after type");
   }
-  // Creates dynamically allocated array of smart pointers to function parameter AST nodes
-  std::vector<std::unique_ptr<FunctionParamASTnode>> params;
+  // Creates array of pointers to function parameter AST nodes
+  std::vector<FunctionParamASTnode *> params;
   if (CurTok.type == LPAR) {
     CurTok = getNextToken(); // eat (
     // Array of function parameter AST nodes is generated by ParseParams production and returned
     params = ParseParams();
   } else {
-    throw LogError("Syntax Error: Expected ( after identifier " + identifier);
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ( after identifier " + Symbols.name(identifier).str());
   }
   if (CurTok.type == RPAR) {
     CurTok = getNextToken(); // eat )
   } else {
-    throw LogError("Syntax Error: Expected ) after parameters");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ) after parameters");
   }
   if (CurTok.type == SC) {
     CurTok = getNextToken(); // eat ;
     // Finally, construct the extern AST node given all the information captured in variables and param array
     // then return pointer to it
-    std::unique_ptr<ExternASTnode> ext = std::make_unique<ExternASTnode>(identifier, type, std::move(params));
-    return std::move(ext);
+    ExternASTnode *ext = Ctx.create<ExternASTnode>(identifier, type, Ctx.copyArray(params));
+    return ext;
   } else {
-    throw LogError("Syntax Error: Expected ; after )");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ; after )");
   }
 }
 
 // type_spec ::= "void"
 //            |  var_type
-static std::string ParseTypeSpec() {
+MiniCType Parser::ParseTypeSpec() {
   // This production simply matches void (specifically for void functions) or any of the 3 remaining types
   // int, float, or bool
-  if (CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK) {
-    std::string type;
+  if (FirstVarType.contains(CurTok.type)) {
+    MiniCType type;
     type = ParseVarType();
     return type;
   } else if (CurTok.type == VOID_TOK) {
-    std::string type = CurTok.lexeme;
     CurTok = getNextToken(); // eat VOID
-    return type;
+    return MiniCType::Void;
   } else {
-    throw LogError("Syntax Error: Expected 'void' or variable type 'int', 'float', or 'bool");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected 'void' or variable type 'int', 'float', or 'bool");
   }
 }
 
 // var_type  ::= "int" |  "float" |  "bool"
-static std::string ParseVarType() {
+MiniCType Parser::ParseVarType() {
   // Match any of int, float, or bool and return outcome
-  std::string type;
   switch (CurTok.type) {
     case INT_TOK: {
       CurTok = getNextToken();
-      type = "int";
-      return type;
+      return MiniCType::Int;
     }
     case FLOAT_TOK: {
       CurTok = getNextToken();
-      type = "float";
-      return type;
+      return MiniCType::Float;
     }
     case BOOL_TOK: {
       CurTok = getNextToken();
-      type = "bool";
-      return type;
+      return MiniCType::Bool;
     }
     default: {
-      throw LogError("Syntax Error: Expected 'int', 'float', or 'bool'");
+      throw LogErrorAt(CurTok, "Syntax Error: Expected 'int', 'float', or 'bool'");
     }
   }
 }
 
 // params ::= param_list  
 //        |  "void" | epsilon
-static std::vector<std::unique_ptr<FunctionParamASTnode>> ParseParams() {
+std::vector<FunctionParamASTnode *> Parser::ParseParams() {
   // Parse the parameter list of a function or extern
   // Either its empty (epsilon), is void, or is a list of parameters
-  // Create dynamically allocated array of smart pointers to function parameter AST nodes
-  std::vector<std::unique_ptr<FunctionParamASTnode>> params;
-  if (CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK) {
+  // Create array of pointers to function parameter AST nodes
+  std::vector<FunctionParamASTnode *> params;
+  if (FirstVarType.contains(CurTok.type)) {
     // We have a parameter list so we the call appropriate production and store the return array in params
     params = ParseParamList();
-    return std::move(params);
+    return params;
   } else if (CurTok.type == VOID_TOK) {
-    // Parameter of function is void, so return a singleton array containing a parameter of name "void" and type "VOID"
-    std::string identifier, type;
-    identifier = CurTok.lexeme;
-    type = "VOID";
+    // Parameter of function is void, so return a singleton array containing a parameter of name "void" and type void
+    SymbolID identifier = Symbols.intern(CurTok.lexeme);
     CurTok = getNextToken();
-    std::unique_ptr<FunctionParamASTnode> void_param = std::make_unique<FunctionParamASTnode>(identifier, type);
-    params.push_back(std::move(void_param));
-    return std::move(params);
+    FunctionParamASTnode *void_param = Ctx.create<FunctionParamASTnode>(identifier, MiniCType::Void);
+    params.push_back(void_param);
+    return params;
   } else if (CurTok.type == RPAR) {
     // Current token is in follow set of params, so there are no parameters and this is valid
-    return std::move(params);
+    return params;
   } else {
     // Current token did not match any previous case, report syntax error
-    throw LogError("Syntax Error: Expected 'void', variable type 'int', 'float', or 'bool', or )");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected 'void', variable type 'int', 'float', or 'bool', or )");
   }
 }
 
 // param_list ::= param param_list_prime
-static std::vector<std::unique_ptr<FunctionParamASTnode>> ParseParamList() {
-  // Parses list of parameters recursively
-  // Creates AST node of first param and array of smart pointers to function param AST nodes
-  std::unique_ptr<FunctionParamASTnode> param;
-  std::vector<std::unique_ptr<FunctionParamASTnode>> params;
+std::vector<FunctionParamASTnode *> Parser::ParseParamList() {
+  // Parses list of parameters
+  // Creates AST node of first param and array of pointers to function param AST nodes
+  FunctionParamASTnode *param;
+  std::vector<FunctionParamASTnode *> params;
   // Matches and stores first param, then adds to end of param array
   param = ParseParam();
-  params.push_back(std::move(param));
-  // Parse remaining params recursively and assign to param arry, then return
-  params = ParseParamListPrime(std::move(params));
-  return std::move(params);
+  params.push_back(param);
+  // Parse remaining params onto the end of the param array, then return
+  ParseParamListPrime(params);
+  return params;
 }
 
 // param_list_prime ::= "," param param_list_prime
 //                    | epsilon
-static std::vector<std::unique_ptr<FunctionParamASTnode>> ParseParamListPrime(std::vector<std::unique_ptr<FunctionParamASTnode>> params) {
-  // Match either a comma or right parenthesis ( ) is in FOLLOW set)
-  if (CurTok.type == COMMA) {
-    // We have a comma call the appropriate productions to param and param_list_prime
+void Parser::ParseParamListPrime(std::vector<FunctionParamASTnode *> &params) {
+  // Each comma starts another param, parsed in a loop rather than recursively
+  while (CurTok.type == COMMA) {
     getNextToken(); // eat comma
     // Create AST node for new param
-    std::unique_ptr<FunctionParamASTnode> param;
+    FunctionParamASTnode *param;
     param = ParseParam();
-    // Add new param to end of param array, generate any further params recursively then return array
-    params.push_back(std::move(param));
-    params = ParseParamListPrime(std::move(params));
-    return std::move(params);
-  } else if (CurTok.type == RPAR) {
-    return std::move(params);
-  } else {
-    throw LogError("Syntax Error: Expected ) or ,");
+    // Add new param to end of param array
+    params.push_back(param);
+  }
+  // Right parenthesis is the only token in the FOLLOW set
+  if (CurTok.type != RPAR) {
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ) or ,");
   }
 }
 
 // param ::= var_type IDENT
-static std::unique_ptr<FunctionParamASTnode> ParseParam() {
-  std::string type;
+FunctionParamASTnode *Parser::ParseParam() {
+  MiniCType type;
   type = ParseVarType();
   if (CurTok.type == IDENT) {
-    std::string identifier = CurTok.lexeme;
-    std::unique_ptr<FunctionParamASTnode> param = std::make_unique<FunctionParamASTnode>(identifier, type);
+    SymbolID identifier = CurTok.sym;
+    FunctionParamASTnode *param = Ctx.create<FunctionParamASTnode>(identifier, type);
     CurTok = getNextToken();
-    return std::move(param);
+    return param;
   } else {
-    throw LogError("Syntax Error: Expected identifier after var_type " + type);
+    throw LogErrorAt(CurTok, "Syntax Error: Expected identifier after var_type " + std::string(typeName(type)));
   }
 }
 
 // decl_list ::= decl decl_list_prime
-static std::vector<std::unique_ptr<ASTnode>> ParseDeclList() {
-  std::vector<std::unique_ptr<ASTnode>> decl_list;
-  std::unique_ptr<ASTnode> decl;
-  decl = ParseDecl();
-  decl_list.push_back(std::move(decl));
-  decl_list = ParseDeclListPrime(std::move(decl_list));
-  return std::move(decl_list);
+std::vector<ASTnode *> Parser::ParseDeclList() {
+  std::vector<ASTnode *> decl_list;
+  ASTnode *decl;
+  decl = ParseReusable(&Parser::ParseDecl);
+  decl_list.push_back(decl);
+  ParseDeclListPrime(decl_list);
+  return decl_list;
 }
 
 // decl_list_prime ::= decl decl_list_prime
 //                    | epsilon
-static std::vector<std::unique_ptr<ASTnode>> ParseDeclListPrime(std::vector<std::unique_ptr<ASTnode>> decl_list) {
-  if (CurTok.type == EOF_TOK) {
-    return std::move(decl_list); // reached end of file, EOF is in FOLLOW set of decl_list_prime
-  } else if (CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK || CurTok.type == VOID_TOK) {
-    std::unique_ptr<ASTnode> decl;
-    decl = ParseDecl();
-    decl_list.push_back(std::move(decl));
-    decl_list = ParseDeclListPrime(std::move(decl_list));
-    return std::move(decl_list);
-  } else {
-    throw LogError("Syntax Error: Expected eof or type 'int', 'float', 'bool', or 'void'");
+void Parser::ParseDeclListPrime(std::vector<ASTnode *> &decl_list) {
+  while (FirstDecl.contains(CurTok.type)) {
+    ASTnode *decl;
+    decl = ParseReusable(&Parser::ParseDecl);
+    decl_list.push_back(decl);
   }
-
+  if (CurTok.type != EOF_TOK) {
+    throw LogErrorAt(CurTok, "Syntax Error: Expected eof or type 'int', 'float', 'bool', or 'void'");
+  }
+  // reached end of file, EOF is in FOLLOW set of decl_list_prime
 }
 
 // decl ::= voidfun_decl
 //     |  typename_decl
-static std::unique_ptr<ASTnode> ParseDecl() {
+ASTnode *Parser::ParseDecl() {
   if (CurTok.type == VOID_TOK) {
-    std::unique_ptr<FunctionDefASTnode> decl;
+    FunctionDefASTnode *decl;
     decl = ParseVoidFunDecl();
     return decl;
-  } else if (CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK) {
-    std::unique_ptr<ASTnode> decl;
+  } else if (FirstVarType.contains(CurTok.type)) {
+    ASTnode *decl;
     decl = ParseTypeNameDecl();
     return decl;
   } else {
-    throw LogError("Syntax Error: Expected type 'void' or variable type 'int', 'float', or 'bool'");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected type 'void' or variable type 'int', 'float', or 'bool'");
   }
 }
 
 // voidfun_decl ::= "void" IDENT "(" params ")" block
-static std::unique_ptr<FunctionDefASTnode> ParseVoidFunDecl() {
-  std::string func_type = CurTok.lexeme;
-  std::string func_identifier;
+FunctionDefASTnode *Parser::ParseVoidFunDecl() {
+  MiniCType func_type = MiniCType::Void;
+  SymbolID func_identifier;
   CurTok = getNextToken(); // eat void
   if (CurTok.type == IDENT) {
-    func_identifier = CurTok.lexeme;
+    func_identifier = CurTok.sym;
     CurTok = getNextToken(); // eat IDENT
   } else {
-    throw LogError("Syntax Error: Expected identifier after type 'void'");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected identifier after type 'void'");
   }
-  std::vector<std::unique_ptr<FunctionParamASTnode>> func_params;
+  std::vector<FunctionParamASTnode *> func_params;
   if (CurTok.type == LPAR) {
     CurTok = getNextToken(); // eat (
     func_params = ParseParams();
   } else {
-    throw LogError("Syntax Error: Expected ( after identifier " + func_identifier);
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ( after identifier " + Symbols.name(func_identifier).str());
   }
   if (CurTok.type == RPAR) {
     CurTok = getNextToken(); // eat )
-    std::unique_ptr<BlockASTnode> func_block;
-    func_block = ParseBlock();
-    std::unique_ptr<FunctionPrototypeASTnode> func_proto = std::make_unique<FunctionPrototypeASTnode>(func_identifier, func_type, std::move(func_params));
-    std::unique_ptr<FunctionDefASTnode> func = std::make_unique<FunctionDefASTnode>(std::move(func_proto), std::move(func_block));
-    return std::move(func);
+    FunctionPrototypeASTnode *func_proto = Ctx.create<FunctionPrototypeASTnode>(func_identifier, func_type, Ctx.copyArray(func_params));
+    return ParseFunctionBody(func_proto);
   } else {
-    throw LogError("Syntax Error: Expected ) after parameters");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ) after parameters");
   }
 }
 
 // typename_decl ::= var_type IDENT varfun_decl
-static std::unique_ptr<ASTnode> ParseTypeNameDecl() {
-  std::string type;
+ASTnode *Parser::ParseTypeNameDecl() {
+  MiniCType type;
   type = ParseVarType();
   if (CurTok.type == IDENT) {
-    std::string identifier;
-    identifier = CurTok.lexeme;
+    SymbolID identifier = CurTok.sym;
     CurTok = getNextToken();
-    std::unique_ptr<FunctionDefASTnode> func = ParseVarFunDecl(type, identifier);
+    FunctionDefASTnode *func = ParseVarFunDecl(type, identifier);
     if (func != nullptr){
-      return std::move(func);
+      return func;
     } else {
-      std::unique_ptr<VariableDeclarationASTnode> variable = std::make_unique<VariableDeclarationASTnode>(identifier, type);
-      return std::move(variable);
+      VariableDeclarationASTnode *variable = Ctx.create<VariableDeclarationASTnode>(identifier, type);
+      return variable;
     }
   } else {
-    throw LogError("Syntax Error: Expected identifier after variable/function type " + type);
+    throw LogErrorAt(CurTok, "Syntax Error: Expected identifier after variable/function type " + std::string(typeName(type)));
   }
 }
 
 // varfun_decl ::= "(" params ")" block
 //                | ";"
-static std::unique_ptr<FunctionDefASTnode> ParseVarFunDecl(std::string type, std::string identifier) {
+FunctionDefASTnode *Parser::ParseVarFunDecl(MiniCType type, SymbolID identifier) {
   if (CurTok.type == LPAR) {
     CurTok = getNextToken(); // eat (
-    std::vector<std::unique_ptr<FunctionParamASTnode>> parameters;
+    std::vector<FunctionParamASTnode *> parameters;
     parameters = ParseParams();
     if (CurTok.type == RPAR) {
       CurTok = getNextToken(); // eat )
-      std::unique_ptr<BlockASTnode> block;
-      block = ParseBlock();
-      std::unique_ptr<FunctionPrototypeASTnode> func_proto = std::make_unique<FunctionPrototypeASTnode>(identifier, type, std::move(parameters));
-      std::unique_ptr<FunctionDefASTnode> func = std::make_unique<FunctionDefASTnode>(std::move(func_proto), std::move(block));
-      return std::move(func);
+      FunctionPrototypeASTnode *func_proto = Ctx.create<FunctionPrototypeASTnode>(identifier, type, Ctx.copyArray(parameters));
+      return ParseFunctionBody(func_proto);
     } else {
-      throw LogError("Syntax Error: Expected ) after parameters");
+      throw LogErrorAt(CurTok, "Syntax Error: Expected ) after parameters");
     }
   } else if (CurTok.type == SC) {
     CurTok = getNextToken(); // eat ;
@@ -1156,115 +1998,149 @@ static std::unique_ptr<FunctionDefASTnode> ParseVarFunDecl(std::string type, std
     return nullptr;
   } else {
     // This is invalid syntax, return nullptr
-    throw LogError("Expected ( after function identifier or ; after variable identifier");
+    throw LogErrorAt(CurTok, "Expected ( after function identifier or ; after variable identifier");
   }
 }
 
-// block ::= "{" local_decls stmt_list "}"
-static std::unique_ptr<BlockASTnode> ParseBlock() {
-  std::vector<std::unique_ptr<VariableDeclarationASTnode>> declarations;
-  std::vector<std::unique_ptr<ASTnode>> statements;
-  if (CurTok.type == LBRA) {
-    CurTok = getNextToken(); // eat {
-  } else {
-    throw LogError("Syntax Error: Expected { at start of block");
-  }
-  if (CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK) {
-    declarations = ParseLocalDecls();
+// Parses the block of a function definition, or in lazy mode skips to the
+// matching "}" and leaves the block to parseLazyBody
+FunctionDefASTnode *Parser::ParseFunctionBody(FunctionPrototypeASTnode *proto) {
+  if (!LazyBodies) {
+    BlockASTnode *block = ParseBlock();
+    return Ctx.create<FunctionDefASTnode>(proto, block);
   }
-  statements = ParseStmtList();
-  if (CurTok.type == RBRA) {
-      CurTok = getNextToken(); // eat }
-  } else {
-    throw LogError("Syntax Error: Expected } at end of block");
+  if (CurTok.type != LBRA) {
+    throw LogErrorAt(CurTok, "Syntax Error: Expected { at start of block");
   }
-  std::unique_ptr<BlockASTnode> block = std::make_unique<BlockASTnode>(std::move(declarations), std::move(statements));
-  return std::move(block);
+  uint32_t body_tok = TokIndex - 1; // CurTok is the "{"
+  TokIndex = Stream->findMatchingBrace(body_tok);
+  CurTok = getNextToken();
+  if (CurTok.type != RBRA) {
+    // The body is never closed, so parse it now to report the same error the
+    // eager parser would
+    TokIndex = body_tok;
+    CurTok = getNextToken();
+    ParseBlock();
+  }
+  CurTok = getNextToken(); // eat }
+  return Ctx.create<FunctionDefASTnode>(proto, this, body_tok);
+}
+
+// Parses a body skipped by ParseFunctionBody, then puts the parser back where
+// it was
+BlockASTnode *Parser::parseLazyBody(uint32_t BodyTok) {
+  TOKEN saved_tok = CurTok;
+  size_t saved_index = TokIndex;
+  TokIndex = BodyTok;
+  CurTok = getNextToken();
+  BlockASTnode *body = ParseBlock();
+  CurTok = saved_tok;
+  TokIndex = saved_index;
+  return body;
+}
+
+BlockASTnode *FunctionDefASTnode::getBody() {
+  if (Body == nullptr) {
+    Body = BodySource->parseLazyBody(BodyTok);
+  }
+  return Body;
+}
+
+// block ::= "{" local_decls stmt_list "}"
+BlockASTnode *Parser::ParseBlock() {
+  std::vector<VariableDeclarationASTnode *> declarations;
+  std::vector<ASTnode *> statements;
+  if (CurTok.type == LBRA) {
+    CurTok = getNextToken(); // eat {
+  } else {
+    throw LogErrorAt(CurTok, "Syntax Error: Expected { at start of block");
+  }
+  if (FirstVarType.contains(CurTok.type)) {
+    declarations = ParseLocalDecls();
+  }
+  statements = ParseStmtList();
+  if (CurTok.type == RBRA) {
+      CurTok = getNextToken(); // eat }
+  } else {
+    throw LogErrorAt(CurTok, "Syntax Error: Expected } at end of block");
+  }
+  BlockASTnode *block = Ctx.create<BlockASTnode>(Ctx.copyArray(declarations), Ctx.copyArray(statements));
+  return block;
 }
 
 // local_decls ::= local_decl local_decls_prime
-static std::vector<std::unique_ptr<VariableDeclarationASTnode>> ParseLocalDecls() {
-  std::vector<std::unique_ptr<VariableDeclarationASTnode>> declarations;
-  if (CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK) {
-    std::unique_ptr<VariableDeclarationASTnode> local_decl;
-    std::vector<std::unique_ptr<VariableDeclarationASTnode>> declarations;
+std::vector<VariableDeclarationASTnode *> Parser::ParseLocalDecls() {
+  std::vector<VariableDeclarationASTnode *> declarations;
+  if (FirstVarType.contains(CurTok.type)) {
+    VariableDeclarationASTnode *local_decl;
+    std::vector<VariableDeclarationASTnode *> declarations;
     local_decl = ParseLocalDecl();
-    declarations.push_back(std::move(local_decl));
-    declarations = ParseLocalDeclsPrime(std::move(declarations));
-    return std::move(declarations);
+    declarations.push_back(local_decl);
+    ParseLocalDeclsPrime(declarations);
+    return declarations;
   } else {
-    throw LogError("Syntax Error: Expected variable type int, float, or bool");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected variable type int, float, or bool");
   }
 }
 
 // local_decls_prime ::= local_decl local_decls_prime
 //                    | epsilon
-static std::vector<std::unique_ptr<VariableDeclarationASTnode>> ParseLocalDeclsPrime(std::vector<std::unique_ptr<VariableDeclarationASTnode>> declarations) {
-  int stmt_token_array[] = {LPAR, MINUS, NOT, IDENT, INT_LIT, FLOAT_LIT, BOOL_LIT, 
-  SC, WHILE, IF, RETURN, LBRA};
-  int size = 12;
-  if (CurTok.type == INT_TOK || CurTok.type == FLOAT_TOK || CurTok.type == BOOL_TOK) {
-    std::unique_ptr<VariableDeclarationASTnode> local_decl;
+void Parser::ParseLocalDeclsPrime(std::vector<VariableDeclarationASTnode *> &declarations) {
+  while (FirstVarType.contains(CurTok.type)) {
+    VariableDeclarationASTnode *local_decl;
     local_decl = ParseLocalDecl();
-    declarations.push_back(std::move(local_decl));
-    declarations = ParseLocalDeclsPrime(std::move(declarations));
-    return std::move(declarations);
-  } else if (CheckMembership(stmt_token_array, size, CurTok.type)) {
-    return std::move(declarations); // CurTok is in FOLLOW set of local_decls_prime, so valid
-  } else {
-    throw LogError("Syntax Error: Expected variable type int, float, or bool for declaration or (, -, !, identifier, int literal, float literal, bool literal, ;, while, if, return, { for statement");
+    declarations.push_back(local_decl);
   }
+  if (!FirstStmt.contains(CurTok.type)) {
+    throw LogErrorAt(CurTok, "Syntax Error: Expected variable type int, float, or bool for declaration or (, -, !, identifier, int literal, float literal, bool literal, ;, while, if, return, { for statement");
+  }
+  // CurTok is in FOLLOW set of local_decls_prime, so valid
 }
 
 // local_decl ::= var_type IDENT ";"
-static std::unique_ptr<VariableDeclarationASTnode> ParseLocalDecl() {
-  std::string var_type;
-  std::unique_ptr<VariableDeclarationASTnode> empty_ptr;
+VariableDeclarationASTnode *Parser::ParseLocalDecl() {
+  MiniCType var_type;
   var_type = ParseVarType();
-  std::string var_name;
+  SymbolID var_name;
   if (CurTok.type == IDENT) {
-    var_name = CurTok.lexeme;
-    std::unique_ptr<VariableASTnode> variable = std::make_unique<VariableASTnode>(var_name);
+    var_name = CurTok.sym;
     CurTok = getNextToken(); // eat IDENT
   } else {
-    throw LogError("Syntax Error: Expected identifier after variable type " + var_type);
+    throw LogErrorAt(CurTok, "Syntax Error: Expected identifier after variable type " + std::string(typeName(var_type)));
   }
   if (CurTok.type == SC) {
     CurTok = getNextToken(); // eat ;
-    std::unique_ptr<VariableDeclarationASTnode> return_ptr = std::make_unique<VariableDeclarationASTnode>(var_name, var_type);
-    return std::move(return_ptr);
+    VariableDeclarationASTnode *return_ptr = Ctx.create<VariableDeclarationASTnode>(var_name, var_type);
+    return return_ptr;
   } else {
-    throw LogError("Syntax Error: Expected ; after identifier " + var_name);
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ; after identifier " + Symbols.name(var_name).str());
   }
 }
 
 // stmt_list ::= stmt stmt_list_prime
-static std::vector<std::unique_ptr<ASTnode>>  ParseStmtList() {
-  std::unique_ptr<ASTnode> stmt;
-  std::vector<std::unique_ptr<ASTnode>> stmt_list;
+std::vector<ASTnode *>  Parser::ParseStmtList() {
+  ASTnode *stmt;
+  std::vector<ASTnode *> stmt_list;
   stmt = ParseStmt();
-  stmt_list.push_back(std::move(stmt));
-  stmt_list = ParseStmtListPrime(std::move(stmt_list));
-  return std::move(stmt_list);
+  stmt_list.push_back(stmt);
+  ParseStmtListPrime(stmt_list);
+  return stmt_list;
 }
 
 // stmt_list_prime ::= stmt stmt_list_prime
 //                    | epsilon
-static std::vector<std::unique_ptr<ASTnode>> ParseStmtListPrime(std::vector<std::unique_ptr<ASTnode>> stmt_list) {
-  int stmt_token_array[] = {LPAR, MINUS, NOT, IDENT, INT_LIT, FLOAT_LIT, BOOL_LIT, 
-  SC, WHILE, IF, RETURN, LBRA};
-  int size = 12;
-  if (CheckMembership(stmt_token_array, size, CurTok.type)) {
-    std::unique_ptr<ASTnode> stmt;
+void Parser::ParseStmtListPrime(std::vector<ASTnode *> &stmt_list) {
+  // Statements at the same level are parsed in a loop, so only nested blocks
+  // add to the parse depth
+  while (FirstStmt.contains(CurTok.type)) {
+    ASTnode *stmt;
     stmt = ParseStmt();
-    stmt_list.push_back(std::move(stmt));
-    stmt_list = ParseStmtListPrime(std::move(stmt_list));
-    return std::move(stmt_list);
-  } else if (CurTok.type == RBRA) {
-    return std::move(stmt_list); // CurTok is in FOLLOW set of stmt_list_prime, so valid
-  } else {
-    throw LogError("Syntax Error: Expected (, -, !, identifier, int literal, float literal, bool literal, ;, while, if, return, { for statement or } for end of statements");
+    stmt_list.push_back(stmt);
   }
+  if (CurTok.type != RBRA) {
+    throw LogErrorAt(CurTok, "Syntax Error: Expected (, -, !, identifier, int literal, float literal, bool literal, ;, while, if, return, { for statement or } for end of statements");
+  }
+  // CurTok is in FOLLOW set of stmt_list_prime, so valid
 }
 
 // stmt ::= expr_stmt 
@@ -1272,564 +2148,304 @@ static std::vector<std::unique_ptr<ASTnode>> ParseStmtListPrime(std::vector<std:
 //    |  if_stmt 
 //    |  while_stmt 
 //    |  return_stmt
-static std::unique_ptr<ASTnode> ParseStmt() {
-  int expr_stmt_array[] = {LPAR, MINUS, NOT, IDENT, INT_LIT, FLOAT_LIT, 
-  BOOL_LIT, SC};
-  int size = 8;
-  if (CheckMembership(expr_stmt_array, size, CurTok.type)) {
-    std::unique_ptr<ASTnode> ptr;
+ASTnode *Parser::ParseStmt() {
+  if (FirstExprStmt.contains(CurTok.type)) {
+    ASTnode *ptr;
     ptr = ParseExprStmt();
-    return std::move(ptr);
+    return ptr;
   } else if (CurTok.type == LBRA) {
-    std::unique_ptr<BlockASTnode> ptr;
+    BlockASTnode *ptr;
     ptr = ParseBlock();
-    return std::move(ptr);
+    return ptr;
   } else if (CurTok.type == IF) {
-    std::unique_ptr<IfExprASTnode> ptr;
+    IfExprASTnode *ptr;
     ptr = ParseIf();
-    return std::move(ptr);
+    return ptr;
   } else if (CurTok.type == WHILE) {
-    std::unique_ptr<WhileExprASTnode> ptr;
+    WhileExprASTnode *ptr;
     ptr = ParseWhile();
-    return std::move(ptr);
+    return ptr;
   } else if (CurTok.type == RETURN) {
-    std::unique_ptr<ReturnExprASTnode> ptr;
+    ReturnExprASTnode *ptr;
     ptr = ParseReturn();
-    return std::move(ptr);
+    return ptr;
   } else {
-    throw LogError("Syntax Error: Expected (, -, !, identifier, int literal, float literal, bool literal, ; for expression statement, { for block statement, if for if statement, while for while statement, or return for return statement");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected (, -, !, identifier, int literal, float literal, bool literal, ; for expression statement, { for block statement, if for if statement, while for while statement, or return for return statement");
   }
 }
 
 // expr_stmt ::= expr ";" 
 //            |  ";"
-static std::unique_ptr<ASTnode> ParseExprStmt() {
-  int expr_array[] = {LPAR, MINUS, NOT, IDENT, INT_LIT, FLOAT_LIT, 
-  BOOL_LIT};
-  int size = 7;
-  if (CheckMembership(expr_array, size, CurTok.type)) {
-    std::unique_ptr<ASTnode> ptr = ParseExpr();
+ASTnode *Parser::ParseExprStmt() {
+  if (FirstExpr.contains(CurTok.type)) {
+    ASTnode *ptr = ParseExpr();
     if (CurTok.type == SC) {
       CurTok = getNextToken(); // eat ;
-      return std::move(ptr);
+      return ptr;
     } else {
-      throw LogError("Syntax Error: Expected ; after expression");
+      throw LogErrorAt(CurTok, "Syntax Error: Expected ; after expression");
     }
   } else if (CurTok.type == SC) {
     CurTok = getNextToken(); // eat ;
     return nullptr;
   } else {
-    throw LogError("Syntax Error: Expected ;");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ;");
   }
 }
 
 // expr ::= IDENT "=" expr
 //     | rval
-static std::unique_ptr<ASTnode> ParseExpr() {
-  int rval_array[] = {LPAR, MINUS, NOT, INT_LIT, FLOAT_LIT, 
-  BOOL_LIT};
-  int size = 6;
-  std::unique_ptr<ASTnode> ptr;
+ASTnode *Parser::ParseExpr() {
+  ASTnode *ptr;
   if (CurTok.type == IDENT) {
     TOKEN last_token = CurTok;
-    std::string variable_name = CurTok.lexeme;
+    SymbolID variable_name = CurTok.sym;
     CurTok = getNextToken();
     if (CurTok.type == ASSIGN) {
-      std::unique_ptr<VariableASTnode> variable = std::make_unique<VariableASTnode>(variable_name);
+      VariableASTnode *variable = Ctx.create<VariableASTnode>(variable_name);
       CurTok = getNextToken(); // eat =
       ptr = ParseExpr();
-      std::unique_ptr<VariableAssignmentASTnode> assignment;
-      assignment = std::make_unique<VariableAssignmentASTnode>(std::move(variable), std::move(ptr));
-      return std::move(assignment);
+      VariableAssignmentASTnode *assignment;
+      assignment = Ctx.create<VariableAssignmentASTnode>(variable, ptr);
+      return assignment;
     } else {
       putBackToken(CurTok);
       CurTok = last_token;
       ptr = ParseRval();
-      return std::move(ptr);
+      return ptr;
     }
-  } else if (CheckMembership(rval_array, size, CurTok.type)) {
+  } else if (FirstExpr.contains(CurTok.type)) {
     ptr = ParseRval();
-    return std::move(ptr);
+    return ptr;
   } else {
-    throw LogError("Syntax Error: Expected assignment of form 'identifier =' or expression");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected assignment of form 'identifier =' or expression");
   }
 }
 
 // if_stmt ::= "if" "(" expr ")" block else_stmt
-static std::unique_ptr<IfExprASTnode> ParseIf() {
+IfExprASTnode *Parser::ParseIf() {
   CurTok = getNextToken(); // eat if
   if (CurTok.type == LPAR) {
     CurTok = getNextToken(); // eat (
   } else {
-    throw LogError("Syntax Error: Expected ( after if");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ( after if");
   }
-  int expr_array[] = {LPAR, MINUS, NOT, IDENT, INT_LIT, FLOAT_LIT, 
-  BOOL_LIT};
-  int size = 7;
-  std::unique_ptr<ASTnode> condition;
-  if (CheckMembership(expr_array, size, CurTok.type)) {
+  ASTnode *condition;
+  if (FirstExpr.contains(CurTok.type)) {
     condition = ParseExpr();
   } else {
-    throw LogError("Syntax Error: Expected expression after (");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected expression after (");
   }
   if (CurTok.type == RPAR) {
     CurTok = getNextToken(); // eat )
   } else {
-    throw LogError("Syntax Error: Expected ) after expression");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ) after expression");
   }
-  std::unique_ptr<BlockASTnode> block;
+  BlockASTnode *block;
   block = ParseBlock();
-  std::unique_ptr<BlockASTnode> else_expression;
+  BlockASTnode *else_expression;
   else_expression = ParseElse();
-  std::unique_ptr<IfExprASTnode> if_expression = std::make_unique<IfExprASTnode>(std::move(condition), std::move(block), std::move(else_expression));
-  return std::move(if_expression);
+  IfExprASTnode *if_expression = Ctx.create<IfExprASTnode>(condition, block, else_expression);
+  return if_expression;
 }
 
 // else_stmt  ::= "else" block
 //             |  epsilon
-static std::unique_ptr<BlockASTnode> ParseElse() {
+BlockASTnode *Parser::ParseElse() {
   // This is an array of possible tokens that can follow an if statement
   // either another statement, or } (RBRA) which is what follows stmt_list
   // If "else" is not seen, then one of these tokens must be
-  int stmt_token_array[] = {RBRA, LPAR, MINUS, NOT, IDENT, INT_LIT, FLOAT_LIT, BOOL_LIT, 
-  SC, WHILE, IF, RETURN, LBRA};
-  int size = 13;
-  std::unique_ptr<BlockASTnode> else_expression;
+  BlockASTnode *else_expression;
   if (CurTok.type == ELSE) {
     CurTok = getNextToken(); // eat else
     else_expression = ParseBlock();
-  } else if (CheckMembership(stmt_token_array, size, CurTok.type)) {
+  } else if (FollowElseStmt.contains(CurTok.type)) {
     return nullptr; // CurTok in FOLLOW set of else_stmt
   } else {
-    throw LogError("Syntax Error: Expected else for else statement or }, (, !, identifier, int literal, float literal, bool literal, ;, while, if, return, { for statement");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected else for else statement or }, (, !, identifier, int literal, float literal, bool literal, ;, while, if, return, { for statement");
   }
-  return std::move(else_expression);
+  return else_expression;
 }
 
 // while_stmt ::= "while" "(" expr ")" stmt
-static std::unique_ptr<WhileExprASTnode> ParseWhile() {
+WhileExprASTnode *Parser::ParseWhile() {
   CurTok = getNextToken(); // eat while
   if (CurTok.type == LPAR) {
     CurTok = getNextToken(); // eat (
   } else {
-    throw LogError("Syntax Error: Expected ( after while");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ( after while");
   }
-  int expr_array[] = {LPAR, MINUS, NOT, IDENT, INT_LIT, FLOAT_LIT, 
-  BOOL_LIT};
-  int size = 7;
-  std::unique_ptr<ASTnode> condition;
-  if (CheckMembership(expr_array, size, CurTok.type)) {
+  ASTnode *condition;
+  if (FirstExpr.contains(CurTok.type)) {
     condition = ParseExpr();
   } else {
-    throw LogError("Syntax Error: Expected expression after (");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected expression after (");
   }
   if (CurTok.type == RPAR) {
     CurTok = getNextToken(); // eat )
-    std::unique_ptr<ASTnode> statement;
+    ASTnode *statement;
     statement = ParseStmt();
-    std::unique_ptr<WhileExprASTnode> return_ptr = std::make_unique<WhileExprASTnode>(std::move(condition), std::move(statement));
-    return std::move(return_ptr);
+    WhileExprASTnode *return_ptr = Ctx.create<WhileExprASTnode>(condition, statement);
+    return return_ptr;
   } else {
-    throw LogError("Syntax Error: Expected ) after expression");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected ) after expression");
   }
 }
 
 // return_stmt ::= "return" ";" 
 //             |  "return" expr ";" 
-static std::unique_ptr<ReturnExprASTnode> ParseReturn() {
+ReturnExprASTnode *Parser::ParseReturn() {
   CurTok = getNextToken(); // eat return
   if (CurTok.type == SC) {
     CurTok = getNextToken(); // eat ;
     // No expression to return so return nullptr
-    std::unique_ptr<ReturnExprASTnode> return_ptr = std::make_unique<ReturnExprASTnode>(nullptr);
-    return std::move(return_ptr);
+    ReturnExprASTnode *return_ptr = Ctx.create<ReturnExprASTnode>(nullptr);
+    return return_ptr;
   } else {
-    std::unique_ptr<ASTnode> return_expr;
+    ASTnode *return_expr;
     return_expr = ParseExpr();
     if (CurTok.type == SC) {
       CurTok = getNextToken(); // eat ;
-      std::unique_ptr<ReturnExprASTnode> return_ptr = std::make_unique<ReturnExprASTnode>(std::move(return_expr));
-      return std::move(return_ptr);
+      ReturnExprASTnode *return_ptr = Ctx.create<ReturnExprASTnode>(return_expr);
+      return return_ptr;
     } else {
-      throw LogError("Syntax Error: Expected ; after expression or after return");
+      throw LogErrorAt(CurTok, "Syntax Error: Expected ; after expression or after return");
     }
   }
 }
 
 // rval ::= rval_one rval_prime
-static std::unique_ptr<ASTnode> ParseRval() {
-  std::unique_ptr<ASTnode> ptr;
-  ptr = ParseRvalOne();
-  if (CurTok.type == OR) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    return_ptr = ParseRvalPrime(std::move(ptr));
-    return std::move(return_ptr);
-  } else {
-    return std::move(ptr);
-  }
-}
-
-// rval_prime ::= "||" rval_one rval_prime | epsilon
-static std::unique_ptr<BinaryASTnode> ParseRvalPrime(std::unique_ptr<ASTnode> lhs) {
-  if (CurTok.type == OR) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    std::string op = CurTok.lexeme;
-    CurTok = getNextToken(); // eat ||
-    std::unique_ptr<ASTnode> rhs;
-    rhs = ParseRvalOne();
-    std::unique_ptr<BinaryASTnode> ptr = std::make_unique<BinaryASTnode>(op, std::move(lhs), std::move(rhs));
-    if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-      return std::move(ptr);
-    } else if (CurTok.type == OR) {
-      return_ptr = ParseRvalPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else {
-      throw LogError("Syntax Error: Expected expression or ;, ), or , after expression");
-    }
-  } else if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-    // No more OR operators follow, return nullptr 
-    return nullptr; // CurTok in FOLLOW set of rval_one_prime
-  } else {
-    // No more OR operators follow, and next symbol not in FOLLOW set - error reported
-    throw LogError("Syntax Error: Expected ;, ), or , after || expression");
-  }
-}
-
-// rval_one ::= rval_two rval_one_prime
-static std::unique_ptr<ASTnode> ParseRvalOne() {
-  std::unique_ptr<ASTnode> ptr;
-  ptr = ParseRvalTwo();
-  if (CurTok.type == AND) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    return_ptr = ParseRvalOnePrime(std::move(ptr));
-    return std::move(return_ptr);
-  } else {
-    return std::move(ptr);
-  }
-}
-
-// rval_one_prime ::= "&&" rval_two rval_one_prime | epsilon
-static std::unique_ptr<BinaryASTnode> ParseRvalOnePrime(std::unique_ptr<ASTnode> lhs) {
-  if (CurTok.type == AND) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    std::string op = CurTok.lexeme;
-    CurTok = getNextToken(); // eat &&
-    std::unique_ptr<ASTnode> rhs;
-    rhs = ParseRvalTwo();
-    std::unique_ptr<BinaryASTnode> ptr = std::make_unique<BinaryASTnode>(op, std::move(lhs), std::move(rhs));
-    if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-      return std::move(ptr);
-    } else if (CurTok.type == AND) {
-      return_ptr = ParseRvalOnePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == OR) {
-      return_ptr = ParseRvalPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else {
-      throw LogError("Syntax Error: Expected expression or ;, ), or , after expression");
-    }
-  } else if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-    // No more AND operators follow, return nullptr 
-    return nullptr; // CurTok in FOLLOW set of rval_one_prime
-  } else {
-    // No more AND operators follow, and next symbol not in FOLLOW set - error reported and nullptr returned
-    throw LogError("Syntax Error: Expected ;, ), or , after && expression");
-  }
-}
-
-// rval_two ::= rval_three rval_two_prime
-static std::unique_ptr<ASTnode> ParseRvalTwo() {
-  std::unique_ptr<ASTnode> ptr;
-  ptr = ParseRvalThree();
-  if (CurTok.type == EQ || CurTok.type == NE) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    return_ptr = ParseRvalTwoPrime(std::move(ptr));
-    return std::move(return_ptr);
-  } else {
-    return std::move(ptr);
-  }
-}
-
-// rval_two_prime ::= "==" rval_three rval_two_prime | "!=" rval_three rval_two_prime | epsilon
-static std::unique_ptr<BinaryASTnode> ParseRvalTwoPrime(std::unique_ptr<ASTnode> lhs) {
-  if (CurTok.type == EQ || CurTok.type == NE) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    std::string op = CurTok.lexeme;
-    CurTok = getNextToken(); // eat == or !=
-    std::unique_ptr<ASTnode> rhs;
-    rhs = ParseRvalThree();
-    std::unique_ptr<BinaryASTnode> ptr = std::make_unique<BinaryASTnode>(op, std::move(lhs), std::move(rhs));
-    if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-      return std::move(ptr);
-    } else if (CurTok.type == EQ || CurTok.type == NE) {
-      return_ptr = ParseRvalTwoPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == AND) {
-      return_ptr = ParseRvalOnePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == OR) {
-      return_ptr = ParseRvalPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else {
-      throw LogError("Syntax Error: Expected expression or ;, ), or , after expression");
-    }
-  } else if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-    // No more equality operators follow, return nullptr 
-    return nullptr; // CurTok in FOLLOW set of rval_two_prime
-  } else {
-    // No more equality operators follow, and next symbol not in FOLLOW set - error reported and nullptr returned
-    throw LogError("Syntax Error: Expected ;, ), or , after == or != expression");
+// rval_one ... rval_five_prime
+// The binary operator levels of the grammar are parsed by precedence climbing
+// over BinaryOps rather than one procedure per level, so an operand
+// costs one ParseRvalSix call and a chain like a+b+c+... is a loop
+ASTnode *Parser::ParseRval() {
+  ASTnode *ptr;
+  ptr = ParseRvalSix();
+  if (binaryPrecedence(CurTok.type) == 0) {
+    return ptr;
   }
-}
-
-// rval_three ::= rval_four rval_three_prime
-static std::unique_ptr<ASTnode> ParseRvalThree() {
-  std::unique_ptr<ASTnode> ptr;
-  ptr = ParseRvalFour();
-  if (CurTok.type == LE || CurTok.type == LT || CurTok.type == GE || CurTok.type == GT) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    return_ptr = ParseRvalThreePrime(std::move(ptr));
-    return std::move(return_ptr);
+  ptr = ParseBinOpRHS(1, ptr);
+  if (FollowRval.contains(CurTok.type)) {
+    return ptr; // CurTok in FOLLOW set of rval
   } else {
-    return std::move(ptr);
-  }
-}
-
-// rval_three_prime ::= "<=" rval_four rval_three_prime | "<" rval_four rval_three_prime | ">=" rval_four rval_three_prime | ">" rval_four rval_three_prime | epsilon
-static std::unique_ptr<BinaryASTnode> ParseRvalThreePrime(std::unique_ptr<ASTnode> lhs) {
-  if (CurTok.type == LE || CurTok.type == LT || CurTok.type == GE || CurTok.type == GT) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    std::string op = CurTok.lexeme;
-    CurTok = getNextToken(); // eat <=, <, >, or >=
-    std::unique_ptr<ASTnode> rhs;
-    rhs = ParseRvalFour();
-    std::unique_ptr<BinaryASTnode> ptr = std::make_unique<BinaryASTnode>(op, std::move(lhs), std::move(rhs));
-    if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-      return std::move(ptr);
-    } else if (CurTok.type == LE || CurTok.type == LT || CurTok.type == GE || CurTok.type == GT){
-      return_ptr = ParseRvalThreePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == EQ || CurTok.type == NE) {
-      return_ptr = ParseRvalTwoPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == AND) {
-      return_ptr = ParseRvalOnePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == OR) {
-      return_ptr = ParseRvalPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else {
-      throw LogError("Syntax Error: Expected expression or ;, ), or , after expression");
-    }
-  } else if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-    // No more comparison operators follow, return nullptr 
-    return nullptr; // CurTok in FOLLOW set of rval_three_prime
-  } else {
-    // No more comparison operators follow, and next symbol not in FOLLOW set - error reported and nullptr returned
-    throw LogError("Syntax Error: Expected ;, ), or , after <=, <, >, or >= expression");
+    throw LogErrorAt(CurTok, "Syntax Error: Expected expression or ;, ), or , after expression");
   }
 }
 
-// rval_four ::= rval_five rval_four_prime
-static std::unique_ptr<ASTnode> ParseRvalFour() {
-  std::unique_ptr<ASTnode> ptr;
-  ptr = ParseRvalFive();
-  if (CurTok.type == PLUS || CurTok.type == MINUS) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    return_ptr = ParseRvalFourPrime(std::move(ptr));
-    return std::move(return_ptr);
-  } else {
-    return std::move(ptr);
-  }
-}
-
-// rval_four_prime ::= "+" rval_five rval_four_prime | "-" rval_five rval_four_prime | epsilon
-static std::unique_ptr<BinaryASTnode> ParseRvalFourPrime(std::unique_ptr<ASTnode> lhs) {
-  if (CurTok.type == PLUS || CurTok.type == MINUS) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    std::string op = CurTok.lexeme;
-    CurTok = getNextToken(); // eat + or -
-    std::unique_ptr<ASTnode> rhs;
-    rhs = ParseRvalFive();
-    std::unique_ptr<BinaryASTnode> ptr = std::make_unique<BinaryASTnode>(op, std::move(lhs), std::move(rhs));
-    if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-      return std::move(ptr);
-    } else if (CurTok.type == PLUS || CurTok.type == MINUS) { // IF ITS PLUS, PASS PTR AS LHS TO RVALFOURPRIME
-      return_ptr = ParseRvalFourPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == LE || CurTok.type == LT || CurTok.type == GE || CurTok.type == GT){
-      return_ptr = ParseRvalThreePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == EQ || CurTok.type == NE) {
-      return_ptr = ParseRvalTwoPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == AND) {
-      return_ptr = ParseRvalOnePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == OR) {
-      return_ptr = ParseRvalPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else {
-      throw LogError("Syntax Error: Expected expression or ;, ), or , after expression");
+// Folds operators of precedence min_prec or higher onto lhs. All operators are
+// left associative, so an operator of equal precedence continues the loop and
+// only a tighter one recurses, which bounds the depth by the number of levels
+ASTnode *Parser::ParseBinOpRHS(int min_prec, ASTnode *lhs) {
+  while (true) {
+    int prec = binaryPrecedence(CurTok.type);
+    if (prec < min_prec) {
+      return lhs;
     }
-  } else if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-    // No more addition/subtraction follows, return nullptr 
-    return nullptr; // CurTok in FOLLOW set of rval_four_prime
-  } else {
-    // No more addition/subtraction follows, and next symbol not in FOLLOW set - error reported and nullptr returned
-    throw LogError("Syntax Error: Expected ;, ), or , after + or - expression");
-  }
-}
-
-// rval_five ::= rval_six rval_five_prime 
-static std::unique_ptr<ASTnode> ParseRvalFive() {
-  std::unique_ptr<ASTnode> ptr;
-  ptr = ParseRvalSix();
-  if (CurTok.type == ASTERIX || CurTok.type == DIV || CurTok.type == MOD) {
-    std::unique_ptr<BinaryASTnode> return_ptr;
-    return_ptr = ParseRvalFivePrime(std::move(ptr));
-    return std::move(return_ptr);
-  } else {
-    return std::move(ptr);
-  }
-}
-
-// rval_five_prime ::= "*" rval_six rval_five_prime | "/" rval_six rval_five_prime | "%" rval_six rval_five_prime | epsilon
-static std::unique_ptr<BinaryASTnode> ParseRvalFivePrime(std::unique_ptr<ASTnode> lhs) {
-  if (CurTok.type == ASTERIX || CurTok.type == DIV || CurTok.type == MOD) {
-    std::unique_ptr<BinaryASTnode> return_ptr; 
-    std::string op = CurTok.lexeme;
-    CurTok = getNextToken(); // eat *, /, or %
-    std::unique_ptr<ASTnode> rhs;
+    BinaryOpcode op = binaryOpcode(CurTok.type);
+    CurTok = getNextToken(); // eat operator
+    ASTnode *rhs;
     rhs = ParseRvalSix();
-    std::unique_ptr<BinaryASTnode> ptr = std::make_unique<BinaryASTnode>(op, std::move(lhs), std::move(rhs));
-    if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-      return std::move(ptr);
-    } else if (CurTok.type == ASTERIX || CurTok.type == DIV || CurTok.type == MOD) {
-      return_ptr = ParseRvalFivePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == PLUS || CurTok.type == MINUS) { // IF ITS PLUS, PASS PTR AS LHS TO RVALFOURPRIME
-      return_ptr = ParseRvalFourPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == LE || CurTok.type == LT || CurTok.type == GE || CurTok.type == GT){
-      return_ptr = ParseRvalThreePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == EQ || CurTok.type == NE) {
-      return_ptr = ParseRvalTwoPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == AND) {
-      return_ptr = ParseRvalOnePrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else if (CurTok.type == OR) {
-      return_ptr = ParseRvalPrime(std::move(ptr));
-      return std::move(return_ptr);
-    } else {
-      throw LogError("Syntax Error: Expected expression or ;, ), or , after expression");
+    // If the next operator binds tighter it takes rhs as its left operand
+    if (binaryPrecedence(CurTok.type) > prec) {
+      rhs = ParseBinOpRHS(prec + 1, rhs);
     }
-  } else if (CurTok.type == SC || CurTok.type == RPAR || CurTok.type == COMMA) {
-    // No more multipliation/division/modulo follows, return nullptr 
-    return nullptr; // CurTok in FOLLOW set of rval_five_prime
-  } else {
-    // No more multipliation/division/modulo follows, and next symbol not in FOLLOW set - error reported and nullptr returned
-    throw LogError("Syntax Error: Expected ;, ), or , after *, /, or % expression");
+    lhs = Ctx.create<BinaryASTnode>(op, lhs, rhs);
   }
 }
 
 // rval_six ::= "-" rval_seven | "!" rval_seven | rval_seven
-static std::unique_ptr<ASTnode> ParseRvalSix() {
-  std::unique_ptr<ASTnode> ptr;
+ASTnode *Parser::ParseRvalSix() {
+  ASTnode *ptr;
   if (CurTok.type == MINUS || CurTok.type == NOT) {
-    std::string op = CurTok.lexeme;
+    UnaryOpcode op = CurTok.type == MINUS ? UnaryOpcode::Neg : UnaryOpcode::Not;
     CurTok = getNextToken(); // eat - or !
     if (CurTok.type == MINUS || CurTok.type == NOT) {
       ptr = ParseRvalSix();
     } else {
       ptr = ParseRvalSeven();
     }
-    std::unique_ptr<UnaryASTnode> return_ptr = std::make_unique<UnaryASTnode>(op, std::move(ptr));
-    return std::move(return_ptr);
+    UnaryASTnode *return_ptr = Ctx.create<UnaryASTnode>(op, ptr);
+    return return_ptr;
   } else {
     ptr = ParseRvalSeven();
-    return std::move(ptr);
+    return ptr;
   }
 }
 
 // rval_seven ::= "(" expr ")" | rval_eight
-static std::unique_ptr<ASTnode> ParseRvalSeven() {
-  std::unique_ptr<ASTnode> ptr;
+ASTnode *Parser::ParseRvalSeven() {
+  ASTnode *ptr;
   if (CurTok.type == LPAR) {
     CurTok = getNextToken(); // eat (
     ptr = ParseExpr();
     if (CurTok.type == RPAR) {
       CurTok = getNextToken(); // eat )
-      return std::move(ptr);
+      return ptr;
     } else {
-      throw LogError("Syntax Error: Expected ) after expression");
+      throw LogErrorAt(CurTok, "Syntax Error: Expected ) after expression");
     }
   } else {
     ptr = ParseRvalEight();
-    return std::move(ptr);
+    return ptr;
   }
 }
 
 // rval_eight ::= IDENT | IDENT "(" args ")" | rval_nine
-static std::unique_ptr<ASTnode> ParseRvalEight() {
+ASTnode *Parser::ParseRvalEight() {
   if (CurTok.type == IDENT) {
-    std::string identifier_name = CurTok.lexeme;
+    SymbolID identifier_name = CurTok.sym;
     CurTok = getNextToken(); // eat IDENT
     if (CurTok.type == LPAR) {
       CurTok = getNextToken(); // eat (
-      std::vector<std::unique_ptr<ASTnode>> args;
+      std::vector<ASTnode *> args;
       args = ParseArgs();
       if (CurTok.type == RPAR) {
         CurTok = getNextToken(); // eat )
-        std::unique_ptr<CallASTnode> ptr = std::make_unique<CallASTnode>(identifier_name, std::move(args));
-        return std::move(ptr);
+        CallASTnode *ptr = Ctx.create<CallASTnode>(identifier_name, Ctx.copyArray(args));
+        return ptr;
       } else {
-        throw LogError("Syntax Error: Expected ) after arguments");
+        throw LogErrorAt(CurTok, "Syntax Error: Expected ) after arguments");
       }
     } else {
       // No ( so this is a simple variable call, create variable AST node and return pointer
-      std::unique_ptr<VariableASTnode> ptr = std::make_unique<VariableASTnode>(identifier_name);
-      return std::move(ptr);
+      VariableASTnode *ptr = Ctx.create<VariableASTnode>(identifier_name);
+      return ptr;
     }
   } else {
-    std::unique_ptr<ASTnode> ptr;
+    ASTnode *ptr;
     ptr = ParseRvalNine();
-    return std::move(ptr);
+    return ptr;
   }
 }
 
 // rval_nine ::= INT_LIT | FLOAT_LIT | BOOL_LIT
-static std::unique_ptr<ASTnode> ParseRvalNine() {
+ASTnode *Parser::ParseRvalNine() {
   // Capture literal value
   switch (CurTok.type) {
     case INT_LIT: {
-      // Read token lexeme and convert to integer, then create an integer literal AST node, return pointer to node
-      int token_value = stoi(CurTok.lexeme);
-      std::unique_ptr<IntASTnode> ptr = std::make_unique<IntASTnode>(token_value);
+      // Take the value the lexer converted, then create an integer literal AST node, return pointer to node
+      int token_value = CurTok.intVal;
+      IntASTnode *ptr = Ctx.create<IntASTnode>(token_value);
       CurTok = getNextToken(); // eat integer
-      return std::move(ptr);
+      return ptr;
     }
     case FLOAT_LIT: {
-      // Read token lexeme and convert to float, then create a float literal AST node, return pointer to node
-      float token_value = stof(CurTok.lexeme);
-      std::unique_ptr<FloatASTnode> ptr = std::make_unique<FloatASTnode>(token_value);
+      // Take the value the lexer converted, then create a float literal AST node, return pointer to node
+      float token_value = CurTok.floatVal;
+      FloatASTnode *ptr = Ctx.create<FloatASTnode>(token_value);
       CurTok = getNextToken(); // eat float
-      return std::move(ptr);
+      return ptr;
     }
     case BOOL_LIT: {
-      // Read token lexeme and convert to boolean, then create a boolean literal AST node, return pointer to node
-      std::string token_value = CurTok.lexeme;
-      bool op;
-      std::istringstream(token_value) >> std::boolalpha >> op;
-      std::unique_ptr<BoolASTnode> ptr = std::make_unique<BoolASTnode>(op);
+      // Take the value the lexer decoded, then create a boolean literal AST node, return pointer to node
+      BoolASTnode *ptr = Ctx.create<BoolASTnode>(CurTok.boolVal);
       CurTok = getNextToken(); // eat boolean
-      return std::move(ptr);
+      return ptr;
     }
     default: {
       // No matches for any rval, syntax error - expression is invalid
-      throw LogError("Syntax Error: Expected paranthesis, binary operation, unary operation, identifier, integer literal, float literal, or bool literal for expression"); // ! No matches for any rvals if it has reached here
+      throw LogErrorAt(CurTok, "Syntax Error: Expected paranthesis, binary operation, unary operation, identifier, integer literal, float literal, or bool literal for expression"); // ! No matches for any rvals if it has reached here
     }
   }
 }
@@ -1837,461 +2453,1331 @@ static std::unique_ptr<ASTnode> ParseRvalNine() {
 // args ::= arg_list 
 //     |  epsilon
 
-static std::vector<std::unique_ptr<ASTnode>> ParseArgs() {
-  int arg_array[] = {LPAR, MINUS, NOT, IDENT, INT_LIT, FLOAT_LIT, 
-  BOOL_LIT};
-  int size = 7;
-  std::vector<std::unique_ptr<ASTnode>> args;
-  if (CheckMembership(arg_array, size, CurTok.type)) {
+std::vector<ASTnode *> Parser::ParseArgs() {
+  std::vector<ASTnode *> args;
+  if (FirstExpr.contains(CurTok.type)) {
     args = ParseArgList();
-    return std::move(args);
+    return args;
   } else if (CurTok.type == RPAR) {
     // CurTok in FOLLOW set of args, no arguments but valid syntax - return empty array of pointers to arguments
-    return std::move(args);
+    return args;
   } else {
     // Invalid syntax, next token not in follow set
-    throw LogError("Syntax Error: Expected (, -, !, identifier, integer literal, float literal, or bool literal for argument or ) for end of arguments"); // no matches for argument, and no closing paranthesis
+    throw LogErrorAt(CurTok, "Syntax Error: Expected (, -, !, identifier, integer literal, float literal, or bool literal for argument or ) for end of arguments"); // no matches for argument, and no closing paranthesis
   }
 }
 
 // arg_list ::= expr arg_list_prime
-static std::vector<std::unique_ptr<ASTnode>> ParseArgList() {
-  std::unique_ptr<ASTnode> arg;
-  std::vector<std::unique_ptr<ASTnode>> args;
+std::vector<ASTnode *> Parser::ParseArgList() {
+  ASTnode *arg;
+  std::vector<ASTnode *> args;
   arg = ParseExpr();
-  args.push_back(std::move(arg));
-  args = ParseArgListPrime(std::move(args));
-  return std::move(args);
+  args.push_back(arg);
+  ParseArgListPrime(args);
+  return args;
 }
 
 // arg_list_prime ::= "," expr arg_list_prime
 //                 | epsilon
-static std::vector<std::unique_ptr<ASTnode>> ParseArgListPrime(std::vector<std::unique_ptr<ASTnode>> args) {
-  if (CurTok.type == COMMA) {
+void Parser::ParseArgListPrime(std::vector<ASTnode *> &args) {
+  while (CurTok.type == COMMA) {
     CurTok = getNextToken(); // eat ,
-    std::unique_ptr<ASTnode> arg;
+    ASTnode *arg;
     arg = ParseExpr();
-    args.push_back(std::move(arg));
-    args = ParseArgListPrime(std::move(args));
-    return std::move(args);
-  } else if (CurTok.type == RPAR) {
-    return std::move(args); // CurTok in FOLLOW set of arg_list_prime
-  } else {
-    // Invalid argument list, return nullptr
-    throw LogError("Syntax Error: Expected , for next argument or ) for end of arguments");
+    args.push_back(arg);
   }
+  if (CurTok.type != RPAR) {
+    // Invalid argument list
+    throw LogErrorAt(CurTok, "Syntax Error: Expected , for next argument or ) for end of arguments");
+  }
+  // CurTok in FOLLOW set of arg_list_prime
 }
 
 //===----------------------------------------------------------------------===//
-// Code Generation
+// Name resolution
 //===----------------------------------------------------------------------===//
 
-static LLVMContext TheContext;
-static IRBuilder<> Builder(TheContext);
-static std::unique_ptr<Module> TheModule;
-static Type *CurFuncType;
-
-// NamedValuesArray stores each different local scope that is created during
-// runtime. Each codegen function takes block_index as a parameter, this block_index
-// is used to access the correct scope stored in NamedValuesArray
-// New scopes are created at function definitions, if statements, else statements, and while
-// statements
-static std::vector<std::map<std::string, AllocaInst *>> NamedValuesArray;
-static std::map<std::string, Value *> GlobalValues;
+/// ScopeStack - the scopes of local variables open in a function, numbered by
+/// nesting depth. Each maps interned names to slots in an open-addressing
+/// table; lookups walk outward from a depth and never insert. Closed scopes
+/// are cleared and kept, so their tables are reused by the next scope at the
+/// same depth. A table starts inline, as most scopes declare only a few
+/// names and are closed again right away.
+class ScopeStack {
+  std::vector<SmallDenseMap<SymbolID, uint32_t, 8>> Scopes;
+  size_t NumOpen = 0;
 
-Value *LogErrorV(std::string Str) {
-  LogError(Str);
-  return nullptr;
-}
+public:
+  // Opens a scope after the last open one
+  void push() {
+    if (NumOpen == Scopes.size())
+      Scopes.emplace_back();
+    NumOpen++;
+  }
 
-// Taken from Finnbar's tutorial lecture - thank you :)
-static AllocaInst *CreateEntryBlockAlloca(Function *TheFunction, const std::string &VarName, const std::string &VarType) { // make work for other types
-  if (VarType == "int") {
-    IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-    return TmpB.CreateAlloca(Type::getInt32Ty(TheContext), 0, VarName.c_str());
-  } else if (VarType == "float") {
-    IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-    return TmpB.CreateAlloca(Type::getFloatTy(TheContext), 0, VarName.c_str());
-  } else if (VarType == "bool") {
-    IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-    return TmpB.CreateAlloca(Type::getInt1Ty(TheContext), 0, VarName.c_str());
+  // Closes the scopes at Depth and deeper
+  void truncate(size_t Depth) {
+    for (size_t Index = Depth; Index < NumOpen; Index++)
+      Scopes[Index].clear();
+    NumOpen = std::min(NumOpen, Depth);
   }
-  return nullptr;
-}
 
-Value *IntASTnode::codegen(int block_index) {
-  return ConstantInt::get(TheContext, APInt(32, Val, true));
-}
+  // A later declaration of the same name in the same scope replaces it
+  void declare(size_t Depth, SymbolID Name, uint32_t Slot) {
+    Scopes[Depth][Name] = Slot;
+  }
 
-Value *FloatASTnode::codegen(int block_index) {
-  return ConstantFP::get(TheContext, APFloat(Val));
-}
+  // Returns the slot Name resolves to at Depth, or NonLocalSlot
+  uint32_t lookup(size_t Depth, SymbolID Name) const {
+    for (size_t Index = Depth + 1; Index-- > 0;) {
+      auto Entry = Scopes[Index].find(Name);
+      if (Entry != Scopes[Index].end())
+        return Entry->second;
+    }
+    return NonLocalSlot;
+  }
+};
 
-Value *BoolASTnode::codegen(int block_index) {
-  return ConstantInt::get(TheContext, APInt(1, Val, false));
-}
+/// LocalResolver - gives every local variable of a function a slot, the
+/// parameters first, and binds every variable reference in its body to the
+/// slot of the declaration it names. The type of each slot is kept for Sema.
+/// A reference to no local in scope keeps NonLocalSlot, and codegen looks it
+/// up among the globals.
+///
+/// The parameters and the body share scope 0. Every other block, whether it is
+/// the arm of an if, the body of a while or stands on its own, opens a scope
+/// one deeper than the one around it, which is closed with everything inside
+/// it when the block ends.
+class LocalResolver : public ASTVisitor<LocalResolver> {
+  ScopeStack Scopes;
+  size_t Depth = 0;
+  std::vector<MiniCType> SlotTypes;
+
+  // NestedScope - keeps a scope one deeper than the current one open for as
+  // long as it lives
+  class NestedScope {
+    LocalResolver &R;
 
-Value *VariableASTnode::codegen(int block_index) {
-  // Defines temporary block index
-  int try_index = block_index;
-  // Uses this block index to try find named variable in current block
-  // If it cannot find the named variable, try_index is decremented and the previous block is
-  // checked - if no block has the named variable, it is assumed to be a global variable
-  AllocaInst *A = NamedValuesArray[try_index][Name];
-  while (A == nullptr && (try_index != 0)) {
-    try_index = try_index - 1;
-    A = NamedValuesArray[try_index][Name];
-  }
-  if (A == nullptr) {
-    GlobalVariable *g = TheModule->getNamedGlobal(Name);
-    // Now check if this global variable exists
-    if (g != nullptr) {
-      Type *var_type;
-      if (g->getInitializer()->getType()->isFloatTy()) {
-        // This is a float global variable
-        var_type = Type::getFloatTy(TheContext);
-      } else if (g->getInitializer()->getType()->isIntegerTy(32)) {
-        // This is an integer global variable
-        var_type = Type::getInt32Ty(TheContext);
-      } else if (g->getInitializer()->getType()->isIntegerTy(1)) {
-        // This is a bool global variable
-        var_type = Type::getInt1Ty(TheContext);
-      }
-      // :Load and return this global variable
-      return Builder.CreateLoad(var_type, g, Name.c_str()); 
+  public:
+    explicit NestedScope(LocalResolver &R) : R(R) {
+      R.Scopes.push();
+      R.Depth++;
+    }
+    ~NestedScope() {
+      R.Scopes.truncate(R.Depth);
+      R.Depth--;
+    }
+  };
 
-    } else {
-      // Global variable does not exist, and variable also does not exist in any block
-      // This is an undefined variable
-      throw LogErrorV("Semantic Error: Undefined variable name " + Name);
+  // Resolves the declarations and statements of N in the innermost open scope
+  void visitContents(BlockASTnode *N) {
+    for (VariableDeclarationASTnode *Decl : N->getDeclarations())
+      visit(Decl);
+    for (ASTnode *Stmt : N->getStatements()) {
+      if (Stmt != nullptr)
+        visit(Stmt);
     }
   }
-  // If a local variable was found in some block, it is loaded and returned
-  return Builder.CreateLoad(A->getAllocatedType(), A, Name.c_str());
-}
 
-Value *VariableDeclarationASTnode::codegen(int block_index) {
-  if (Builder.GetInsertBlock() == nullptr) {
-    // This must be a global variable declaration since there is no insert block
-    llvm::Type *var_type;
-    // Find type of variable and create as LLVM Type
-    if (Type == "int") {
-      var_type = Type::getInt32Ty(TheContext);
-    } else if (Type == "float") {
-      var_type = Type::getFloatTy(TheContext);
-    } else if (Type == "bool") {
-      var_type = Type::getInt1Ty(TheContext);
-    }
-    // Create global variable and set alignment
-    GlobalVariable *g = new GlobalVariable(*(TheModule.get()), var_type, false, GlobalValue::CommonLinkage, Constant::getNullValue(var_type), Name);
-    g->setAlignment(MaybeAlign(4));
-    GlobalValues[Name] = g;
-  } else {
-    // This is a local variable since there is an insert block
-    Function *TheFunction = Builder.GetInsertBlock()->getParent();
-    // Allocate memory for this variable and assign to current block
-    AllocaInst *Variable = CreateEntryBlockAlloca(TheFunction, Name, Type);
-    NamedValuesArray[block_index][Name] = Variable;
+public:
+  void visitVariable(VariableASTnode *N) {
+    N->setSlot(Scopes.lookup(Depth, N->getName()));
+  }
+  void visitVariableAssignment(VariableAssignmentASTnode *N) {
+    visit(N->getVal());
+    visit(N->getVariable());
+  }
+  void visitVariableDeclaration(VariableDeclarationASTnode *N) {
+    N->setSlot(SlotTypes.size());
+    SlotTypes.push_back(N->getType());
+    Scopes.declare(Depth, N->getName(), N->getSlot());
+  }
+  void visitBlock(BlockASTnode *N) {
+    NestedScope Scope(*this);
+    visitContents(N);
+  }
+  void visitBinary(BinaryASTnode *N) {
+    visit(N->getLHS());
+    visit(N->getRHS());
+  }
+  void visitUnary(UnaryASTnode *N) { visit(N->getOperand()); }
+  void visitCast(CastASTnode *N) { visit(N->getOperand()); }
+  void visitCall(CallASTnode *N) {
+    for (ASTnode *Arg : N->getArgs())
+      visit(Arg);
+  }
+  void visitIfExpr(IfExprASTnode *N) {
+    visit(N->getCond());
+    visit(N->getThen());
+    if (N->getElse() != nullptr)
+      visit(N->getElse());
+  }
+  void visitWhileExpr(WhileExprASTnode *N) {
+    visit(N->getCond());
+    visit(N->getBody());
+  }
+  void visitReturnExpr(ReturnExprASTnode *N) {
+    if (N->getReturnValue() != nullptr)
+      visit(N->getReturnValue());
   }
-  return nullptr;
-}
 
-Value *VariableAssignmentASTnode::codegen(int block_index) {
-    VariableASTnode *target_variable = dynamic_cast<VariableASTnode *>(Variable.get());
-    if (target_variable == nullptr) {
-      throw LogErrorV("Semantic Error: LHS of assignment '=' must be a variable");
+  // Resolves the function with prototype Proto and body Body, returning the
+  // number of slots it needs. Parameter i gets slot i.
+  uint32_t resolve(FunctionPrototypeASTnode *Proto, BlockASTnode *Body) {
+    Scopes.truncate(0);
+    Scopes.push();
+    Depth = 0;
+    SlotTypes.clear();
+    for (FunctionParamASTnode *Param : Proto->getArgs()) {
+      // The placeholder parameter of "(void)" is not a variable
+      if (Param->getType() != MiniCType::Void) {
+        Scopes.declare(0, Param->getName(), SlotTypes.size());
+        SlotTypes.push_back(Param->getType());
+      }
     }
-    // Generate IR for assigned value
-    Value *assigned_val = Val->codegen(block_index);
-    if (assigned_val == nullptr) {
+    visitContents(Body);
+    return SlotTypes.size();
+  }
+
+  ArrayRef<MiniCType> getSlotTypes() const { return SlotTypes; }
+};
+
+//===----------------------------------------------------------------------===//
+// Semantic analysis
+//===----------------------------------------------------------------------===//
+
+/// Sema - checks the whole program before any IR is built, so that codegen
+/// only has to lower it. Every expression gets its type, the locals of every
+/// function are resolved with LocalResolver, and every implicit conversion
+/// becomes an explicit CastASTnode. An error is reported where it is found and
+/// checking goes on, so that one run reports them all; an expression with an
+/// error in it has no type, which keeps it from causing more errors.
+///
+/// As in codegen, a global or function can only be used after it is declared.
+class Sema : public ASTVisitor<Sema, Optional<MiniCType>> {
+  ASTContext &Ctx;
+  LocalResolver Locals;
+  DenseMap<SymbolID, MiniCType> Globals;
+  // Return type and parameters of each function, from its first declaration
+  DenseMap<SymbolID, std::pair<MiniCType, ArrayRef<FunctionParamASTnode *>>>
+      Functions;
+  ArrayRef<MiniCType> LocalTypes; // Of the function being checked, by slot
+  MiniCType ReturnType = MiniCType::Void;
+  unsigned NumErrors = 0;
+
+  Optional<MiniCType> error(const std::string &Str) {
+    LogError(Str);
+    NumErrors++;
+    return None;
+  }
+
+  // Makes the implicit conversion of E from From to To explicit, with a
+  // warning. Only float converts to and from int and bool; for anything else
+  // this reports an error and returns nullptr.
+  ASTnode *convert(ASTnode *E, MiniCType From, MiniCType To,
+                   const char *Context) {
+    if ((From == MiniCType::Float) == (To == MiniCType::Float) ||
+        From == MiniCType::Void || To == MiniCType::Void) {
+      error(std::string("Semantic Error: cannot convert ") + typeName(From) +
+            " to " + typeName(To) + " while " + Context);
       return nullptr;
     }
+    LogError(std::string("Warning: implicit type conversion from ") +
+             typeName(From) + " to " + typeName(To) + " while " + Context);
+    return Ctx.create<CastASTnode>(To, E);
+  }
 
-    // Defines temporary block index
-    int try_index = block_index;
-    // Uses this block index to try find named variable in current block
-    // If it cannot find the named variable, try_index is decremented and the previous block is
-    // checked - if no block has the named variable, it is assumed to be a global variable
-    AllocaInst *Variable = NamedValuesArray[try_index][target_variable->getName()];
-    while (Variable == nullptr && (try_index != 0)) {
-      try_index = try_index - 1;
-      Variable = NamedValuesArray[try_index][target_variable->getName()];
-    }
+  void checkCondition(ASTnode *Cond, const char *Stmt) {
+    Optional<MiniCType> Type = visit(Cond);
+    if (Type && *Type != MiniCType::Bool)
+      error(std::string("Semantic Error: condition of ") + Stmt +
+            " must be of type bool, not " + typeName(*Type));
+  }
 
-    if (Variable == nullptr) {
-      // Check if this global variable exists
-      GlobalVariable *g = TheModule->getNamedGlobal(target_variable->getName());
-      if (g != nullptr) {
-        Builder.CreateStore(assigned_val, g);
-        return assigned_val;
-      }
-      // Global variable does not exist, and variable also does not exist in any block
-      // This is an undefined variable
-      throw LogErrorV("Semantic Error: Undefined variable name " + target_variable->getName());
-    }
-    // Check if declared type of variable is the same as the type of attempted value to assign
-    if (assigned_val->getType() != Variable->getAllocatedType()){
-      // Types not same, e.g. trying to assign float to a variable declared as int
-      // Change type of assigned value to be equal to declared type of variable
-      // Then warn of this implicit type conversion
-      if (Variable->getAllocatedType()->isIntegerTy()) {
-        assigned_val = Builder.CreateFPToSI(assigned_val, Variable->getAllocatedType());
-        LogErrorV("Warning: implicit type conversion from float to int while assigning value to variable");
-      } else if (Variable->getAllocatedType()->isFloatTy()) {
-        assigned_val = Builder.CreateSIToFP(assigned_val, Variable->getAllocatedType());
-        LogErrorV("Warning: implicit type conversion from int to float while assigning value to variable");
-      }
-    }
-    Builder.CreateStore(assigned_val, Variable);
-    return assigned_val;
-}
+  void declareFunction(SymbolID Name, MiniCType Type,
+                       ArrayRef<FunctionParamASTnode *> Params) {
+    Functions.try_emplace(Name, Type, Params);
+  }
 
-Value *BinaryASTnode::codegen(int block_index) {
-  // Generate IR code for LHS and RHS
-  Value *L = LHS->codegen(block_index);
-  Value *R = RHS->codegen(block_index);
+public:
+  Sema(ASTContext &Ctx) : Ctx(Ctx) {}
 
-  if (L == nullptr || R == nullptr) {
-    return nullptr;
+  Optional<MiniCType> visitInt(IntASTnode *N) {
+    N->setExprType(MiniCType::Int);
+    return MiniCType::Int;
   }
-  // Get types of LHS and RHS
-  Type *L_type = L->getType();
-  Type *R_type = R->getType();
-
-  // If either operand is of type float, perform float operations (implicit conversion of int to float and warning)
-  if (L_type->isFloatTy() || R_type->isFloatTy()) {
-    if (!L_type->isFloatTy()) {
-      // Convert to float and give warning
-      L = Builder.CreateSIToFP(L, Type::getFloatTy(TheContext), "convtmp");
-      LogErrorV("Warning: implicit type conversion from int to float while performing binary operation");
-    } else if (!R_type->isFloatTy()) {
-      // Convert to float and give warning
-      R = Builder.CreateSIToFP(R, Type::getFloatTy(TheContext), "convtmp");
-      LogErrorV("Warning: implicit type conversion from int to float while performing binary operation");
-    }
-    // Match the correct binary operator and build corresponding IR
-    if (Op == "+") {
-      return Builder.CreateFAdd(L, R, "addftmp");
-    } else if (Op == "-") {
-      return Builder.CreateFSub(L, R, "subftmp");
-    } else if (Op == "*") {
-      return Builder.CreateFMul(L, R, "mulftmp");
-    } else if (Op == "/") {
-      return Builder.CreateFDiv(L, R, "divftmp");
-    } else if (Op == "%") {
-      return Builder.CreateFRem(L, R, "remftmp");
-    } else if (Op == "<") {
-      return Builder.CreateFCmpULT(L, R, "sltftmp");
-    } else if (Op == "<=") {
-      return Builder.CreateFCmpULE(L, R, "sleftmp");
-    } else if (Op == ">=") {
-      return Builder.CreateFCmpUGE(L, R, "sgeftmp");
-    } else if (Op == ">") {
-      return Builder.CreateFCmpUGT(L, R, "sgtftmp");
-    } else if (Op == "==") {
-      return Builder.CreateFCmpUEQ(L, R, "eqftmp");
-    } else if (Op == "!=") {
-      return Builder.CreateFCmpUNE(L, R, "neftmp");
-    } else if (Op == "&&") {
-      return Builder.CreateAnd(L, R, "andftmp");
-    } else if (Op == "||") {
-      return Builder.CreateOr(L, R, "orftmp");
-    } else {
-      // Currently this would never be reached as the parser would catch any undefined
-      // binary operators, but this allows for an extension allowing user-defined binary operators
-      // similar to the Kaleidoscope tutorial
-      throw LogErrorV("Syntax Error: Invalid binary operator"); 
-    }
-  } else {
-    // Match the correct binary operator and build corresponding IR
-    if (Op == "+") {
-      return Builder.CreateAdd(L, R, "addtmp");
-    } else if (Op == "-") {
-      return Builder.CreateSub(L, R, "subtmp");
-    } else if (Op == "*") {
-      return Builder.CreateMul(L, R, "multmp");
-    } else if (Op == "/") {
-      return Builder.CreateSDiv(L, R, "divtmp");
-    } else if (Op == "%") {
-      return Builder.CreateURem(L, R, "remtmp");
-    } else if (Op == "<") {
-      return Builder.CreateICmpSLT(L, R, "slttmp");
-    } else if (Op == "<=") {
-      return Builder.CreateICmpSLE(L, R, "sletmp");
-    } else if (Op == ">=") {
-      return Builder.CreateICmpSGE(L, R, "sgetmp");
-    } else if (Op == ">") {
-      return Builder.CreateICmpSGT(L, R, "sgttmp");
-    } else if (Op == "==") {
-      return Builder.CreateICmpEQ(L, R, "eqtmp");
-    } else if (Op == "!=") {
-      return Builder.CreateICmpNE(L, R, "netmp");
-    } else if (Op == "&&") {
-      return Builder.CreateAnd(L, R, "andtmp");
-    } else if (Op == "||") {
-      return Builder.CreateOr(L, R, "ortmp");
-    } else {
-      // Currently this would never be reached as the parser would catch any undefined
-      // binary operators, but this allows for an extension allowing user-defined binary operators
-      // similar to the Kaleidoscope tutorial
-      throw LogErrorV("Syntax Error: Invalid binary operator");
-    }
+  Optional<MiniCType> visitFloat(FloatASTnode *N) {
+    N->setExprType(MiniCType::Float);
+    return MiniCType::Float;
+  }
+  Optional<MiniCType> visitBool(BoolASTnode *N) {
+    N->setExprType(MiniCType::Bool);
+    return MiniCType::Bool;
   }
-}
 
-Value *UnaryASTnode::codegen(int block_index) {
-  // Generate IR code for operand and pass in block_index for correct scope
-  Value *Operand = Val->codegen(block_index);
-  Type *Operand_type = Operand->getType();
-  // Check type of operand and make corresponding calls to generate IR code
-  if (Operand_type->isFloatTy()) {
-    if (Op == "-") {
-      return Builder.CreateFNeg(Operand, "negftmp");
-    } else if (Op == "!") {
-      return Builder.CreateNot(Operand, "nottmp");
-    } else {
-      // Currently this would never be reached as the parser would catch any undefined
-      // unary operators, but this allows for an extension allowing user-defined unary operators
-      // similar to the Kaleidoscope tutorial
-      // The same applies to any further calls in this function
-      throw LogErrorV("Syntax Error: Invalid unary operator");
-    }
-  } else if (Operand_type->isIntegerTy(32)) {
-    if (Op == "-") {
-      return Builder.CreateNeg(Operand, "negtmp");
-    } else if (Op == "!") {
-      return Builder.CreateNot(Operand, "nottmp");
+  Optional<MiniCType> visitVariable(VariableASTnode *N) {
+    MiniCType Type;
+    if (N->getSlot() != NonLocalSlot) {
+      Type = LocalTypes[N->getSlot()];
     } else {
-      throw LogErrorV("Syntax Error: Invalid unary operator");
+      auto Global = Globals.find(N->getName());
+      if (Global == Globals.end())
+        return error("Semantic Error: Undefined variable name " +
+                     Symbols.name(N->getName()).str());
+      Type = Global->second;
     }
-  } else if (Operand_type->isIntegerTy(1)) {
-    if (Op == "-") {
-      return Builder.CreateNeg(Operand, "negftmp");
-    } else if (Op == "!") {
-      return Builder.CreateNot(Operand, "nottmp");
-    } else {
-      LogErrorV("Invalid unary operator");
-      return nullptr;
+    N->setExprType(Type);
+    return Type;
+  }
+
+  Optional<MiniCType> visitVariableAssignment(VariableAssignmentASTnode *N) {
+    if (N->getVariable() == nullptr)
+      return error("Semantic Error: LHS of assignment '=' must be a variable");
+    Optional<MiniCType> Val = visit(N->getVal());
+    Optional<MiniCType> Var = visit(N->getVariable());
+    if (!Val || !Var)
+      return None;
+    if (*Val != *Var) {
+      ASTnode *Converted = convert(N->getVal(), *Val, *Var,
+                                   "assigning value to variable");
+      if (Converted == nullptr)
+        return None;
+      N->setVal(Converted);
     }
-  } else {
-    throw LogErrorV("Syntax Error: Invalid unary operand type");
+    N->setExprType(*Var);
+    return *Var;
   }
-}
 
-Value *BlockASTnode::codegen(int block_index) {
-  // Loop through all declarations and statements and generate IR code
-  // Pass in block_index to each to allow further function calls to have access
-  // to the correct scope
-  Value *RetVal;
-  for (auto &Decl : Declarations) {
-    RetVal = Decl->codegen(block_index);
+  Optional<MiniCType> visitBlock(BlockASTnode *N) {
+    // The locals were declared by LocalResolver
+    for (ASTnode *Stmt : N->getStatements()) {
+      if (Stmt != nullptr)
+        visit(Stmt);
+    }
+    return MiniCType::Void;
   }
-  for (auto &Stmt : Statements) {
-    RetVal = Stmt->codegen(block_index);
+
+  // Arithmetic takes two ints, two bools or two floats, converting an int or
+  // bool operand to float if the other one is. Comparisons take the same and
+  // give a bool; && and || take ints or bools.
+  Optional<MiniCType> visitBinary(BinaryASTnode *N) {
+    Optional<MiniCType> LHS = visit(N->getLHS());
+    Optional<MiniCType> RHS = visit(N->getRHS());
+    if (!LHS || !RHS)
+      return None;
+    BinaryOpcode Op = N->getOp();
+    std::string Operator = std::string("'") + opSpelling(Op) + "'";
+    if (*LHS == MiniCType::Void || *RHS == MiniCType::Void)
+      return error("Semantic Error: void value used as operand of " + Operator);
+    MiniCType Operands = *LHS;
+    if (*LHS == MiniCType::Float || *RHS == MiniCType::Float) {
+      if (Op == BinaryOpcode::And || Op == BinaryOpcode::Or)
+        return error("Semantic Error: operands of " + Operator +
+                     " cannot be of type float");
+      if (*LHS != MiniCType::Float)
+        N->setLHS(convert(N->getLHS(), *LHS, MiniCType::Float,
+                          "performing binary operation"));
+      else if (*RHS != MiniCType::Float)
+        N->setRHS(convert(N->getRHS(), *RHS, MiniCType::Float,
+                          "performing binary operation"));
+      Operands = MiniCType::Float;
+    } else if (*LHS != *RHS) {
+      return error("Semantic Error: operands of " + Operator +
+                   " have different types " + typeName(*LHS) + " and " +
+                   typeName(*RHS));
+    }
+    bool IsComparison = Op >= BinaryOpcode::Eq && Op <= BinaryOpcode::Gt;
+    MiniCType Result = IsComparison ? MiniCType::Bool : Operands;
+    N->setExprType(Result);
+    return Result;
   }
-  return RetVal;
-}
 
-Value *FunctionParamASTnode::codegen(int block_index) {
-  // This does not need to generate any IR
-  return nullptr;
-}
+  Optional<MiniCType> visitUnary(UnaryASTnode *N) {
+    Optional<MiniCType> Operand = visit(N->getOperand());
+    if (!Operand)
+      return None;
+    if (*Operand == MiniCType::Void ||
+        (*Operand == MiniCType::Float && N->getOp() == UnaryOpcode::Not))
+      return error(std::string("Semantic Error: invalid operand type ") +
+                   typeName(*Operand) + " for unary operator '" +
+                   opSpelling(N->getOp()) + "'");
+    N->setExprType(*Operand);
+    return *Operand;
+  }
 
-Function *FunctionPrototypeASTnode::codegen(int block_index) {
-  // Get types of all parameters
-  std::vector<llvm::Type *> params;
-  for (auto &Arg : Args) {
-    if (Arg->getType() == "int") {
-      params.push_back(Type::getInt32Ty(TheContext));
-    } else if (Arg->getType() == "float") {
-      params.push_back(Type::getFloatTy(TheContext));
-    } else if (Arg->getType() == "bool") {
-      params.push_back(Type::getInt1Ty(TheContext));
+  Optional<MiniCType> visitCall(CallASTnode *N) {
+    auto Callee = Functions.find(N->getCallee());
+    if (Callee == Functions.end())
+      return error("Semantic Error: Undefined function referenced " +
+                   Symbols.name(N->getCallee()).str());
+    SmallVector<MiniCType, 8> ParamTypes;
+    for (FunctionParamASTnode *Param : Callee->second.second) {
+      // The placeholder parameter of "(void)" takes no argument
+      if (Param->getType() != MiniCType::Void)
+        ParamTypes.push_back(Param->getType());
     }
+    ArrayRef<ASTnode *> Args = N->getArgs();
+    if (ParamTypes.size() != Args.size())
+      return error("Semantic Error: Incorrect number of arguments passed into function, expected " +
+                   std::to_string(ParamTypes.size()) + " but got " +
+                   std::to_string(Args.size()));
+    bool Valid = true;
+    for (unsigned Index = 0; Index < Args.size(); Index++) {
+      Optional<MiniCType> Arg = visit(Args[Index]);
+      if (!Arg) {
+        Valid = false;
+      } else if (*Arg != ParamTypes[Index]) {
+        ASTnode *Converted = convert(Args[Index], *Arg, ParamTypes[Index],
+                                     "passing argument to function");
+        if (Converted == nullptr)
+          Valid = false;
+        else
+          N->setArg(Index, Converted);
+      }
+    }
+    if (!Valid)
+      return None;
+    N->setExprType(Callee->second.first);
+    return Callee->second.first;
   }
 
-  // Get return type of function
-  FunctionType *FT;
-  if (Type == "float") {
-    FT = FunctionType::get(Type::getFloatTy(TheContext), params, false);
-    CurFuncType = Type::getFloatTy(TheContext);
-  } else if (Type == "bool") {
-    FT = FunctionType::get(Type::getInt1Ty(TheContext), params, false);
-    CurFuncType = Type::getInt1Ty(TheContext);
-  } else if (Type == "int") {
-    FT = FunctionType::get(Type::getInt32Ty(TheContext), params, false);
-    CurFuncType = Type::getInt32Ty(TheContext);
-  } else if (Type == "void") {
-    FT = FunctionType::get(Type::getVoidTy(TheContext), params, false);
-    CurFuncType = Type::getVoidTy(TheContext);
+  Optional<MiniCType> visitFunctionDef(FunctionDefASTnode *N) {
+    FunctionPrototypeASTnode *Proto = N->getPrototype();
+    // Declared before the body is checked, so it can call itself
+    declareFunction(Proto->getName(), Proto->getType(), Proto->getArgs());
+    BlockASTnode *Body = N->getBody();
+    N->setNumSlots(Locals.resolve(Proto, Body));
+    LocalTypes = Locals.getSlotTypes();
+    ReturnType = Proto->getType();
+    visit(Body);
+    return MiniCType::Void;
   }
-  // Construct function given its FunctionType
-  Function *F = Function::Create(FT, Function::ExternalLinkage, Name, TheModule.get());
-  // Set argument names
-  unsigned Idx = 0;
-  for (auto &Arg : F->args()) {
-    Arg.setName(Args[Idx]->getName());
-    Idx++;
+
+  Optional<MiniCType> visitExtern(ExternASTnode *N) {
+    declareFunction(N->getName(), N->getType(), N->getParams());
+    return MiniCType::Void;
   }
 
-  return F;
-}
+  Optional<MiniCType> visitIfExpr(IfExprASTnode *N) {
+    checkCondition(N->getCond(), "if statement");
+    visit(N->getThen());
+    if (N->getElse() != nullptr)
+      visit(N->getElse());
+    return MiniCType::Void;
+  }
 
-Function *ExternASTnode::codegen(int block_index) {
-  // Exact same as PrototypeASTnode
-  std::vector<llvm::Type *> params;
-  for (auto &Arg : Params) {
-    if (Arg->getType() == "int") {
-      params.push_back(Type::getInt32Ty(TheContext));
-    } else if (Arg->getType() == "float") {
-      params.push_back(Type::getFloatTy(TheContext));
-    } else if (Arg->getType() == "bool") {
-      params.push_back(Type::getInt1Ty(TheContext));
+  Optional<MiniCType> visitWhileExpr(WhileExprASTnode *N) {
+    checkCondition(N->getCond(), "while statement");
+    visit(N->getBody());
+    return MiniCType::Void;
+  }
+
+  Optional<MiniCType> visitReturnExpr(ReturnExprASTnode *N) {
+    if (N->getReturnValue() == nullptr) {
+      if (ReturnType != MiniCType::Void)
+        return error("Semantic Error: return type of function is non-void but return expression does not return a value");
+      return MiniCType::Void;
     }
+    Optional<MiniCType> Value = visit(N->getReturnValue());
+    if (Value && *Value != ReturnType)
+      return error("Semantic Error: return type of function does not match type of return expression");
+    return MiniCType::Void;
   }
 
-  FunctionType *FT;
-  if (Type == "float") {
-    FT = FunctionType::get(Type::getFloatTy(TheContext), params, false);
-    CurFuncType = Type::getFloatTy(TheContext);
-  } else if (Type == "bool") {
-    FT = FunctionType::get(Type::getInt1Ty(TheContext), params, false);
-    CurFuncType = Type::getInt1Ty(TheContext);
-  } else if (Type == "int") {
-    FT = FunctionType::get(Type::getInt32Ty(TheContext), params, false);
-    CurFuncType = Type::getInt32Ty(TheContext);
-  } else if (Type == "void") {
-    FT = FunctionType::get(Type::getVoidTy(TheContext), params, false);
-    CurFuncType = Type::getVoidTy(TheContext);
-  }
-  
-  Function *F = Function::Create(FT, Function::ExternalLinkage, Name, TheModule.get());
+  Optional<MiniCType> visitRoot(RootASTnode *N) {
+    for (ExternASTnode *Ext : N->getExterns())
+      visit(Ext);
+    for (ASTnode *Decl : N->getDecls()) {
+      if (auto *Global = dyn_cast<VariableDeclarationASTnode>(Decl))
+        Globals[Global->getName()] = Global->getType();
+      else
+        visit(Decl);
+    }
+    return MiniCType::Void;
+  }
 
-  unsigned Idx = 0;
-  for (auto &Arg : F->args()) {
-    Arg.setName(Params[Idx]->getName());
-    Idx++;
+  // Checks Root, returning whether it is free of errors
+  bool check(RootASTnode *Root) {
+    visit(Root);
+    return NumErrors == 0;
   }
+};
 
-  return F;
-}
+//===----------------------------------------------------------------------===//
+// Constant folding
+//===----------------------------------------------------------------------===//
 
-Function *FunctionDefASTnode::codegen(int block_index) {
-  // block_index stores the index at which this blocks local variables are stored in NamedValuesArray
-  // set to 0 when a new function is being defined as all variables are out of scope - except global variables
-  // which are accessed directly with TheModule->getNamedGlobal()
-  block_index = 0;
-  // Create new local variable table and clear array of local variable tables for new function
-  std::map<std::string, AllocaInst *> NamedValues;
-  NamedValuesArray.clear();
-  // Add new local variable table to array
-  NamedValuesArray.push_back(NamedValues);
-  Function *TheFunction = TheModule->getFunction(Prototype->getName());
-  if (TheFunction == nullptr) {
-    // Generate IR code for function prototype
-    TheFunction = Prototype->codegen(block_index);
+/// StoreFinder - collects the variables a statement may assign, and whether it
+/// calls any function, since a call may assign any global
+class StoreFinder : public ASTVisitor<StoreFinder> {
+public:
+  SmallVector<VariableASTnode *, 8> Stored;
+  bool Calls = false;
+
+  void visitVariableAssignment(VariableAssignmentASTnode *N) {
+    visit(N->getVal());
+    Stored.push_back(N->getVariable());
   }
-  if (TheFunction == nullptr) {
+  void visitBlock(BlockASTnode *N) {
+    for (ASTnode *Stmt : N->getStatements()) {
+      if (Stmt != nullptr)
+        visit(Stmt);
+    }
+  }
+  void visitBinary(BinaryASTnode *N) {
+    visit(N->getLHS());
+    visit(N->getRHS());
+  }
+  void visitUnary(UnaryASTnode *N) { visit(N->getOperand()); }
+  void visitCast(CastASTnode *N) { visit(N->getOperand()); }
+  void visitCall(CallASTnode *N) {
+    for (ASTnode *Arg : N->getArgs())
+      visit(Arg);
+    Calls = true;
+  }
+  void visitIfExpr(IfExprASTnode *N) {
+    visit(N->getCond());
+    visit(N->getThen());
+    if (N->getElse() != nullptr)
+      visit(N->getElse());
+  }
+  void visitWhileExpr(WhileExprASTnode *N) {
+    visit(N->getCond());
+    visit(N->getBody());
+  }
+  void visitReturnExpr(ReturnExprASTnode *N) {
+    if (N->getReturnValue() != nullptr)
+      visit(N->getReturnValue());
+  }
+};
+
+/// Simplifier - folds the operators whose operands are literals, following
+/// the same int, float and bool semantics as the IR codegen builds for them,
+/// and removes the if and while statements whose condition is a literal.
+///
+/// A variable read where its value is known to be a literal is replaced by
+/// that literal. What is known flows forward through each function, the way
+/// codegen evaluates it: an assignment of a literal makes the variable known
+/// and any other assignment forgets it, a call forgets every global, both
+/// arms of an if keep only what they agree on, and a while forgets everything
+/// it may assign before its condition is read.
+///
+/// Runs after Sema on a checked tree. Each visit returns the node to put in
+/// place of the one visited, or for a statement nullptr to remove it.
+class Simplifier : public ASTVisitor<Simplifier, ASTnode *> {
+  // Literal value of each known local, by slot, and global, by name
+  struct KnownValues {
+    DenseMap<uint32_t, ASTnode *> Locals;
+    DenseMap<SymbolID, ASTnode *> Globals;
+  };
+
+  ASTContext &Ctx;
+  KnownValues Known;
+
+  ASTnode *intLiteral(int Val) {
+    ASTnode *N = Ctx.create<IntASTnode>(Val);
+    N->setExprType(MiniCType::Int);
+    return N;
+  }
+  ASTnode *floatLiteral(float Val) {
+    ASTnode *N = Ctx.create<FloatASTnode>(Val);
+    N->setExprType(MiniCType::Float);
+    return N;
+  }
+  ASTnode *boolLiteral(bool Val) {
+    ASTnode *N = Ctx.create<BoolASTnode>(Val);
+    N->setExprType(MiniCType::Bool);
+    return N;
+  }
+
+  static bool isLiteral(const ASTnode *N) {
+    return isa<IntASTnode>(N) || isa<FloatASTnode>(N) || isa<BoolASTnode>(N);
+  }
+
+  // Whether the literals A and B hold the same value. Floats are compared by
+  // bits, so that 0.0 and -0.0 differ and a NaN equals itself.
+  static bool sameLiteral(const ASTnode *A, const ASTnode *B) {
+    if (A == B)
+      return true;
+    if (A->getKind() != B->getKind())
+      return false;
+    if (auto *Int = dyn_cast<IntASTnode>(A))
+      return Int->getVal() == cast<IntASTnode>(B)->getVal();
+    if (auto *Float = dyn_cast<FloatASTnode>(A))
+      return bit_cast<uint32_t>(Float->getVal()) ==
+             bit_cast<uint32_t>(cast<FloatASTnode>(B)->getVal());
+    return cast<BoolASTnode>(A)->getVal() == cast<BoolASTnode>(B)->getVal();
+  }
+
+  // Keeps only the values Other knows to be the same
+  template <typename KeyT>
+  static void intersect(DenseMap<KeyT, ASTnode *> &Values,
+                        const DenseMap<KeyT, ASTnode *> &Other) {
+    SmallVector<KeyT, 8> Differ;
+    for (auto &Entry : Values) {
+      ASTnode *Value = Other.lookup(Entry.first);
+      if (Value == nullptr || !sameLiteral(Value, Entry.second))
+        Differ.push_back(Entry.first);
+    }
+    for (KeyT Key : Differ)
+      Values.erase(Key);
+  }
+
+  void forget(VariableASTnode *Var) {
+    if (Var->getSlot() != NonLocalSlot)
+      Known.Locals.erase(Var->getSlot());
+    else
+      Known.Globals.erase(Var->getName());
+  }
+
+  // The result of an int operation as codegen builds it on i32: +, - and *
+  // wrap, / is sdiv and % is urem. nullptr for a division LLVM leaves
+  // undefined, by zero or of INT32_MIN by -1.
+  ASTnode *foldInt(BinaryOpcode Op, int L, int R) {
+    uint32_t UL = L, UR = R;
+    switch (Op) {
+    case BinaryOpcode::Add:
+      return intLiteral(UL + UR);
+    case BinaryOpcode::Sub:
+      return intLiteral(UL - UR);
+    case BinaryOpcode::Mul:
+      return intLiteral(UL * UR);
+    case BinaryOpcode::Div:
+      if (R == 0 || (L == INT32_MIN && R == -1))
+        return nullptr;
+      return intLiteral(L / R);
+    case BinaryOpcode::Rem:
+      if (R == 0)
+        return nullptr;
+      return intLiteral(UL % UR);
+    case BinaryOpcode::Lt:
+      return boolLiteral(L < R);
+    case BinaryOpcode::Le:
+      return boolLiteral(L <= R);
+    case BinaryOpcode::Ge:
+      return boolLiteral(L >= R);
+    case BinaryOpcode::Gt:
+      return boolLiteral(L > R);
+    case BinaryOpcode::Eq:
+      return boolLiteral(L == R);
+    case BinaryOpcode::Ne:
+      return boolLiteral(L != R);
+    case BinaryOpcode::And:
+      return intLiteral(UL & UR);
+    case BinaryOpcode::Or:
+      return intLiteral(UL | UR);
+    }
+    llvm_unreachable("invalid binary operator");
+  }
+
+  // The result of a bool operation as codegen builds it on i1, where true is
+  // -1 to the signed comparisons and / and % are only defined by true
+  ASTnode *foldBool(BinaryOpcode Op, bool L, bool R) {
+    int SL = L ? -1 : 0, SR = R ? -1 : 0;
+    switch (Op) {
+    case BinaryOpcode::Add:
+    case BinaryOpcode::Sub:
+      return boolLiteral(L != R);
+    case BinaryOpcode::Mul:
+    case BinaryOpcode::And:
+      return boolLiteral(L && R);
+    case BinaryOpcode::Or:
+      return boolLiteral(L || R);
+    case BinaryOpcode::Div:
+      // -1 / -1 overflows like INT32_MIN / -1 does
+      if (!R || L)
+        return nullptr;
+      return boolLiteral(false);
+    case BinaryOpcode::Rem:
+      if (!R)
+        return nullptr;
+      return boolLiteral(false);
+    case BinaryOpcode::Lt:
+      return boolLiteral(SL < SR);
+    case BinaryOpcode::Le:
+      return boolLiteral(SL <= SR);
+    case BinaryOpcode::Ge:
+      return boolLiteral(SL >= SR);
+    case BinaryOpcode::Gt:
+      return boolLiteral(SL > SR);
+    case BinaryOpcode::Eq:
+      return boolLiteral(L == R);
+    case BinaryOpcode::Ne:
+      return boolLiteral(L != R);
+    }
+    llvm_unreachable("invalid binary operator");
+  }
+
+  // The result of a float operation as codegen builds it, computed the way
+  // LLVM folds one, where every comparison is unordered and so true if either
+  // operand is a NaN
+  ASTnode *foldFloat(BinaryOpcode Op, float L, float R) {
+    APFloat Result(L), Other(R);
+    APFloat::cmpResult Cmp = Result.compare(Other);
+    bool Unordered = Cmp == APFloat::cmpUnordered;
+    switch (Op) {
+    case BinaryOpcode::Add:
+      Result.add(Other, APFloat::rmNearestTiesToEven);
+      return floatLiteral(Result.convertToFloat());
+    case BinaryOpcode::Sub:
+      Result.subtract(Other, APFloat::rmNearestTiesToEven);
+      return floatLiteral(Result.convertToFloat());
+    case BinaryOpcode::Mul:
+      Result.multiply(Other, APFloat::rmNearestTiesToEven);
+      return floatLiteral(Result.convertToFloat());
+    case BinaryOpcode::Div:
+      Result.divide(Other, APFloat::rmNearestTiesToEven);
+      return floatLiteral(Result.convertToFloat());
+    case BinaryOpcode::Rem:
+      Result.mod(Other);
+      return floatLiteral(Result.convertToFloat());
+    case BinaryOpcode::Lt:
+      return boolLiteral(Unordered || Cmp == APFloat::cmpLessThan);
+    case BinaryOpcode::Le:
+      return boolLiteral(Unordered || Cmp != APFloat::cmpGreaterThan);
+    case BinaryOpcode::Ge:
+      return boolLiteral(Unordered || Cmp != APFloat::cmpLessThan);
+    case BinaryOpcode::Gt:
+      return boolLiteral(Unordered || Cmp == APFloat::cmpGreaterThan);
+    case BinaryOpcode::Eq:
+      return boolLiteral(Unordered || Cmp == APFloat::cmpEqual);
+    case BinaryOpcode::Ne:
+      return boolLiteral(Cmp != APFloat::cmpEqual);
+    case BinaryOpcode::And:
+    case BinaryOpcode::Or:
+      // Sema rejects these on floats
+      break;
+    }
+    return nullptr;
+  }
+
+  // Visits a statement that must stay one, such as the body of a while
+  ASTnode *visitStatement(ASTnode *N) {
+    if (ASTnode *Simplified = visit(N))
+      return Simplified;
+    return Ctx.create<BlockASTnode>(ArrayRef<VariableDeclarationASTnode *>(),
+                                    ArrayRef<ASTnode *>());
+  }
+
+public:
+  Simplifier(ASTContext &Ctx) : Ctx(Ctx) {}
+
+  ASTnode *visitInt(IntASTnode *N) { return N; }
+  ASTnode *visitFloat(FloatASTnode *N) { return N; }
+  ASTnode *visitBool(BoolASTnode *N) { return N; }
+
+  ASTnode *visitVariable(VariableASTnode *N) {
+    ASTnode *Value = N->getSlot() != NonLocalSlot
+                         ? Known.Locals.lookup(N->getSlot())
+                         : Known.Globals.lookup(N->getName());
+    return Value != nullptr ? Value : N;
+  }
+
+  ASTnode *visitVariableAssignment(VariableAssignmentASTnode *N) {
+    N->setVal(visit(N->getVal()));
+    VariableASTnode *Var = N->getVariable();
+    if (!isLiteral(N->getVal()))
+      forget(Var);
+    else if (Var->getSlot() != NonLocalSlot)
+      Known.Locals[Var->getSlot()] = N->getVal();
+    else
+      Known.Globals[Var->getName()] = N->getVal();
+    return N;
+  }
+
+  ASTnode *visitBlock(BlockASTnode *N) {
+    // Statements are moved down over the removed ones
+    ArrayRef<ASTnode *> Stmts = N->getStatements();
+    size_t NumKept = 0;
+    for (size_t Index = 0; Index < Stmts.size(); Index++) {
+      if (Stmts[Index] == nullptr)
+        continue;
+      if (ASTnode *Stmt = visit(Stmts[Index]))
+        N->setStatement(NumKept++, Stmt);
+    }
+    N->setNumStatements(NumKept);
+    return N;
+  }
+
+  ASTnode *visitBinary(BinaryASTnode *N) {
+    N->setLHS(visit(N->getLHS()));
+    N->setRHS(visit(N->getRHS()));
+    ASTnode *L = N->getLHS(), *R = N->getRHS();
+    ASTnode *Folded = nullptr;
+    if (auto *LInt = dyn_cast<IntASTnode>(L)) {
+      if (auto *RInt = dyn_cast<IntASTnode>(R))
+        Folded = foldInt(N->getOp(), LInt->getVal(), RInt->getVal());
+    } else if (auto *LFloat = dyn_cast<FloatASTnode>(L)) {
+      if (auto *RFloat = dyn_cast<FloatASTnode>(R))
+        Folded = foldFloat(N->getOp(), LFloat->getVal(), RFloat->getVal());
+    } else if (auto *LBool = dyn_cast<BoolASTnode>(L)) {
+      if (auto *RBool = dyn_cast<BoolASTnode>(R))
+        Folded = foldBool(N->getOp(), LBool->getVal(), RBool->getVal());
+    }
+    return Folded != nullptr ? Folded : N;
+  }
+
+  ASTnode *visitUnary(UnaryASTnode *N) {
+    N->setOperand(visit(N->getOperand()));
+    ASTnode *Operand = N->getOperand();
+    bool Neg = N->getOp() == UnaryOpcode::Neg;
+    if (auto *Int = dyn_cast<IntASTnode>(Operand)) {
+      uint32_t Val = Int->getVal();
+      return intLiteral(Neg ? 0u - Val : ~Val);
+    }
+    if (auto *Float = dyn_cast<FloatASTnode>(Operand))
+      return floatLiteral(-Float->getVal());
+    // On i1 negation leaves a bool as it is
+    if (auto *Bool = dyn_cast<BoolASTnode>(Operand))
+      return Neg ? Bool : boolLiteral(!Bool->getVal());
+    return N;
+  }
+
+  // Conversions are sitofp and fptosi, so true converts to -1.0, and a float
+  // out of the range of the type it converts to is left to codegen
+  ASTnode *visitCast(CastASTnode *N) {
+    N->setOperand(visit(N->getOperand()));
+    ASTnode *Operand = N->getOperand();
+    if (auto *Int = dyn_cast<IntASTnode>(Operand))
+      return floatLiteral(static_cast<float>(Int->getVal()));
+    if (auto *Bool = dyn_cast<BoolASTnode>(Operand))
+      return floatLiteral(Bool->getVal() ? -1.0f : 0.0f);
+    auto *Float = dyn_cast<FloatASTnode>(Operand);
+    if (Float == nullptr)
+      return N;
+    float Trunc = std::trunc(Float->getVal());
+    if (N->getExprType() == MiniCType::Bool) {
+      if (Trunc == 0.0f || Trunc == -1.0f)
+        return boolLiteral(Trunc != 0.0f);
+    } else if (Trunc >= -2147483648.0f && Trunc < 2147483648.0f) {
+      return intLiteral(static_cast<int>(Trunc));
+    }
+    return N;
+  }
+
+  ASTnode *visitCall(CallASTnode *N) {
+    ArrayRef<ASTnode *> Args = N->getArgs();
+    for (unsigned Index = 0; Index < Args.size(); Index++)
+      N->setArg(Index, visit(Args[Index]));
+    Known.Globals.clear();
+    return N;
+  }
+
+  ASTnode *visitIfExpr(IfExprASTnode *N) {
+    N->setCond(visit(N->getCond()));
+    if (auto *Cond = dyn_cast<BoolASTnode>(N->getCond())) {
+      // Only the arm the condition picks is ever run
+      BlockASTnode *Taken = Cond->getVal() ? N->getThen() : N->getElse();
+      return Taken != nullptr ? visit(Taken) : nullptr;
+    }
+    KnownValues Before = Known;
+    visit(N->getThen());
+    std::swap(Known, Before);
+    if (N->getElse() != nullptr)
+      visit(N->getElse());
+    intersect(Known.Locals, Before.Locals);
+    intersect(Known.Globals, Before.Globals);
+    return N;
+  }
+
+  ASTnode *visitWhileExpr(WhileExprASTnode *N) {
+    // Nothing the loop may assign is known from before it, in its condition,
+    // its body or after it
+    StoreFinder Stores;
+    Stores.visit(N);
+    for (VariableASTnode *Var : Stores.Stored)
+      forget(Var);
+    if (Stores.Calls)
+      Known.Globals.clear();
+    N->setCond(visit(N->getCond()));
+    auto *Cond = dyn_cast<BoolASTnode>(N->getCond());
+    if (Cond != nullptr && !Cond->getVal())
+      return nullptr;
+    KnownValues Before = Known;
+    N->setBody(visitStatement(N->getBody()));
+    Known = std::move(Before);
+    return N;
+  }
+
+  ASTnode *visitReturnExpr(ReturnExprASTnode *N) {
+    if (N->getReturnValue() != nullptr)
+      N->setReturnValue(visit(N->getReturnValue()));
+    return N;
+  }
+
+  ASTnode *visitFunctionDef(FunctionDefASTnode *N) {
+    // Nothing is known of the parameters or the globals on entry
+    Known.Locals.clear();
+    Known.Globals.clear();
+    visit(N->getBody());
+    return N;
+  }
+
+  ASTnode *visitRoot(RootASTnode *N) {
+    for (ASTnode *Decl : N->getDecls()) {
+      if (isa<FunctionDefASTnode>(Decl))
+        visit(Decl);
+    }
+    return N;
+  }
+
+  void simplify(RootASTnode *Root) { visit(Root); }
+};
+
+//===----------------------------------------------------------------------===//
+// Call graph
+//===----------------------------------------------------------------------===//
+
+/// CallGraph - walks the calls of a program out from some of its functions,
+/// by name. The body of a function is only visited, and so only parsed if it
+/// is lazy, once the walk reaches it. Calls to externs are edges like any
+/// other, into functions with no edges of their own.
+class CallGraph : public ASTVisitor<CallGraph> {
+  DenseMap<SymbolID, SmallVector<FunctionDefASTnode *, 1>> Definitions;
+  DenseSet<SymbolID> Reached;
+  SmallVector<SymbolID, 16> Worklist;
+
+  void reach(SymbolID Name) {
+    if (Reached.insert(Name).second)
+      Worklist.push_back(Name);
+  }
+
+public:
+  explicit CallGraph(RootASTnode *Root) {
+    for (ASTnode *Decl : Root->getDecls()) {
+      if (auto *Def = dyn_cast<FunctionDefASTnode>(Decl))
+        Definitions[Def->getPrototype()->getName()].push_back(Def);
+    }
+  }
+
+  void visitVariableAssignment(VariableAssignmentASTnode *N) {
+    visit(N->getVal());
+  }
+  void visitBlock(BlockASTnode *N) {
+    for (ASTnode *Stmt : N->getStatements()) {
+      if (Stmt != nullptr)
+        visit(Stmt);
+    }
+  }
+  void visitBinary(BinaryASTnode *N) {
+    visit(N->getLHS());
+    visit(N->getRHS());
+  }
+  void visitUnary(UnaryASTnode *N) { visit(N->getOperand()); }
+  void visitCast(CastASTnode *N) { visit(N->getOperand()); }
+  void visitCall(CallASTnode *N) {
+    reach(N->getCallee());
+    for (ASTnode *Arg : N->getArgs())
+      visit(Arg);
+  }
+  void visitIfExpr(IfExprASTnode *N) {
+    visit(N->getCond());
+    visit(N->getThen());
+    if (N->getElse() != nullptr)
+      visit(N->getElse());
+  }
+  void visitWhileExpr(WhileExprASTnode *N) {
+    visit(N->getCond());
+    visit(N->getBody());
+  }
+  void visitReturnExpr(ReturnExprASTnode *N) {
+    if (N->getReturnValue() != nullptr)
+      visit(N->getReturnValue());
+  }
+
+  // Returns the functions Roots call, directly or through others, and Roots
+  // themselves
+  DenseSet<SymbolID> reachableFrom(ArrayRef<SymbolID> Roots) {
+    for (SymbolID Root : Roots)
+      reach(Root);
+    while (!Worklist.empty()) {
+      auto Defs = Definitions.find(Worklist.pop_back_val());
+      if (Defs == Definitions.end())
+        continue;
+      for (FunctionDefASTnode *Def : Defs->second)
+        visit(Def->getBody());
+    }
+    return std::move(Reached);
+  }
+};
+
+// Removes the function definitions and externs of Root that no function of
+// Exports calls, directly or not, so that Sema does not check them and codegen
+// does not lower them. The lazy bodies of the functions removed are never
+// parsed. Returns false, after reporting it, if an export is not a function of
+// Root.
+static bool removeDeadFunctions(ASTContext &Ctx, RootASTnode *Root,
+                                ArrayRef<StringRef> Exports) {
+  DenseSet<SymbolID> Declared;
+  for (ExternASTnode *Ext : Root->getExterns())
+    Declared.insert(Ext->getName());
+  for (ASTnode *Decl : Root->getDecls()) {
+    if (auto *Def = dyn_cast<FunctionDefASTnode>(Decl))
+      Declared.insert(Def->getPrototype()->getName());
+  }
+  SmallVector<SymbolID, 8> Roots;
+  for (StringRef Name : Exports) {
+    SymbolID Root = Symbols.intern(Name);
+    if (!Declared.contains(Root)) {
+      LogError("Unknown function in --export: " + Name.str());
+      return false;
+    }
+    Roots.push_back(Root);
+  }
+
+  DenseSet<SymbolID> Live = CallGraph(Root).reachableFrom(Roots);
+  // Global variables are kept whether or not a live function uses them
+  std::vector<ExternASTnode *> Externs;
+  for (ExternASTnode *Ext : Root->getExterns()) {
+    if (Live.contains(Ext->getName()))
+      Externs.push_back(Ext);
+  }
+  std::vector<ASTnode *> Decls;
+  for (ASTnode *Decl : Root->getDecls()) {
+    auto *Def = dyn_cast<FunctionDefASTnode>(Decl);
+    if (Def == nullptr || Live.contains(Def->getPrototype()->getName()))
+      Decls.push_back(Decl);
+  }
+  Root->setExterns(Ctx.copyArray(Externs));
+  Root->setDecls(Ctx.copyArray(Decls));
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Code Generation
+//===----------------------------------------------------------------------===//
+
+static LLVMContext TheContext;
+static IRBuilder<> Builder(TheContext);
+static std::unique_ptr<Module> TheModule;
+
+// Allocas of the locals of the function being generated, indexed by the slots
+// LocalResolver gave them
+static std::vector<AllocaInst *> LocalSlots;
+// Globals and functions are looked up by interned name rather than by
+// searching TheModule's string tables
+static DenseMap<SymbolID, GlobalVariable *> GlobalValues;
+static DenseMap<SymbolID, Function *> FunctionValues;
+
+// LLVM type of each Mini-C type, indexed by MiniCType
+static llvm::Type *const LLVMTypes[] = {
+    Type::getVoidTy(TheContext), Type::getInt32Ty(TheContext),
+    Type::getFloatTy(TheContext), Type::getInt1Ty(TheContext)};
+
+static llvm::Type *getLLVMType(MiniCType Ty) {
+  return LLVMTypes[static_cast<int>(Ty)];
+}
+
+// Taken from Finnbar's tutorial lecture - thank you :)
+static AllocaInst *CreateEntryBlockAlloca(Function *TheFunction, StringRef VarName, MiniCType VarType) {
+  IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
+  return TmpB.CreateAlloca(getLLVMType(VarType), 0, VarName);
+}
+
+Value *ASTnode::codegen(int block_index) {
+  switch (Kind) {
+  case NK_Int:
+    return cast<IntASTnode>(this)->codegen(block_index);
+  case NK_Float:
+    return cast<FloatASTnode>(this)->codegen(block_index);
+  case NK_Bool:
+    return cast<BoolASTnode>(this)->codegen(block_index);
+  case NK_Variable:
+    return cast<VariableASTnode>(this)->codegen(block_index);
+  case NK_VariableAssignment:
+    return cast<VariableAssignmentASTnode>(this)->codegen(block_index);
+  case NK_VariableDeclaration:
+    return cast<VariableDeclarationASTnode>(this)->codegen(block_index);
+  case NK_Block:
+    return cast<BlockASTnode>(this)->codegen(block_index);
+  case NK_Binary:
+    return cast<BinaryASTnode>(this)->codegen(block_index);
+  case NK_Unary:
+    return cast<UnaryASTnode>(this)->codegen(block_index);
+  case NK_Cast:
+    return cast<CastASTnode>(this)->codegen(block_index);
+  case NK_Call:
+    return cast<CallASTnode>(this)->codegen(block_index);
+  case NK_FunctionParam:
+    return cast<FunctionParamASTnode>(this)->codegen(block_index);
+  case NK_FunctionPrototype:
+    return cast<FunctionPrototypeASTnode>(this)->codegen(block_index);
+  case NK_FunctionDef:
+    return cast<FunctionDefASTnode>(this)->codegen(block_index);
+  case NK_Extern:
+    return cast<ExternASTnode>(this)->codegen(block_index);
+  case NK_IfExpr:
+    return cast<IfExprASTnode>(this)->codegen(block_index);
+  case NK_WhileExpr:
+    return cast<WhileExprASTnode>(this)->codegen(block_index);
+  case NK_ReturnExpr:
+    return cast<ReturnExprASTnode>(this)->codegen(block_index);
+  case NK_Root:
+    return cast<RootASTnode>(this)->codegen(block_index);
+  }
+  llvm_unreachable("unknown AST node kind");
+}
+
+Value *IntASTnode::codegen(int block_index) {
+  return ConstantInt::get(TheContext, APInt(32, Val, true));
+}
+
+Value *FloatASTnode::codegen(int block_index) {
+  return ConstantFP::get(TheContext, APFloat(Val));
+}
+
+Value *BoolASTnode::codegen(int block_index) {
+  return ConstantInt::get(TheContext, APInt(1, Val, false));
+}
+
+Value *VariableASTnode::codegen(int block_index) {
+  // A variable that is not a local in scope is a global variable, which Sema
+  // made sure is declared
+  if (Slot == NonLocalSlot) {
+    GlobalVariable *g = GlobalValues.lookup(Name);
+    return Builder.CreateLoad(getLLVMType(getExprType()), g, Symbols.name(Name));
+  }
+  // Otherwise the local variable is loaded and returned
+  AllocaInst *A = LocalSlots[Slot];
+  return Builder.CreateLoad(A->getAllocatedType(), A, Symbols.name(Name));
+}
+
+Value *VariableDeclarationASTnode::codegen(int block_index) {
+  if (Builder.GetInsertBlock() == nullptr) {
+    // This must be a global variable declaration since there is no insert block
+    llvm::Type *var_type = getLLVMType(Type);
+    // Create global variable and set alignment
+    GlobalVariable *g = new GlobalVariable(*(TheModule.get()), var_type, false, GlobalValue::CommonLinkage, Constant::getNullValue(var_type), Symbols.name(Name));
+    g->setAlignment(MaybeAlign(4));
+    GlobalValues[Name] = g;
+  } else {
+    // This is a local variable since there is an insert block
+    Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    // Allocate memory for this variable and assign to current block
+    LocalSlots[Slot] = CreateEntryBlockAlloca(TheFunction, Symbols.name(Name), Type);
+  }
+  return nullptr;
+}
+
+Value *VariableAssignmentASTnode::codegen(int block_index) {
+  // Generate IR for assigned value, which Sema converted to the variable's type
+  Value *assigned_val = Val->codegen(block_index);
+  // A variable that is not a local in scope is a global variable
+  if (Variable->getSlot() == NonLocalSlot) {
+    Builder.CreateStore(assigned_val, GlobalValues.lookup(Variable->getName()));
+  } else {
+    Builder.CreateStore(assigned_val, LocalSlots[Variable->getSlot()]);
+  }
+  return assigned_val;
+}
+
+// Builds Op on L and R. Sema gave both operands the same type, OperandType, so
+// either both are floats and float operations are performed, or neither is.
+static Value *createBinaryOp(BinaryOpcode Op, MiniCType OperandType, Value *L,
+                             Value *R) {
+  if (OperandType == MiniCType::Float) {
+    // Match the correct binary operator and build corresponding IR
+    switch (Op) {
+    case BinaryOpcode::Add:
+      return Builder.CreateFAdd(L, R, "addftmp");
+    case BinaryOpcode::Sub:
+      return Builder.CreateFSub(L, R, "subftmp");
+    case BinaryOpcode::Mul:
+      return Builder.CreateFMul(L, R, "mulftmp");
+    case BinaryOpcode::Div:
+      return Builder.CreateFDiv(L, R, "divftmp");
+    case BinaryOpcode::Rem:
+      return Builder.CreateFRem(L, R, "remftmp");
+    case BinaryOpcode::Lt:
+      return Builder.CreateFCmpULT(L, R, "sltftmp");
+    case BinaryOpcode::Le:
+      return Builder.CreateFCmpULE(L, R, "sleftmp");
+    case BinaryOpcode::Ge:
+      return Builder.CreateFCmpUGE(L, R, "sgeftmp");
+    case BinaryOpcode::Gt:
+      return Builder.CreateFCmpUGT(L, R, "sgtftmp");
+    case BinaryOpcode::Eq:
+      return Builder.CreateFCmpUEQ(L, R, "eqftmp");
+    case BinaryOpcode::Ne:
+      return Builder.CreateFCmpUNE(L, R, "neftmp");
+    case BinaryOpcode::And:
+      return Builder.CreateAnd(L, R, "andftmp");
+    case BinaryOpcode::Or:
+      return Builder.CreateOr(L, R, "orftmp");
+    }
+  } else {
+    // Match the correct binary operator and build corresponding IR
+    switch (Op) {
+    case BinaryOpcode::Add:
+      return Builder.CreateAdd(L, R, "addtmp");
+    case BinaryOpcode::Sub:
+      return Builder.CreateSub(L, R, "subtmp");
+    case BinaryOpcode::Mul:
+      return Builder.CreateMul(L, R, "multmp");
+    case BinaryOpcode::Div:
+      return Builder.CreateSDiv(L, R, "divtmp");
+    case BinaryOpcode::Rem:
+      return Builder.CreateURem(L, R, "remtmp");
+    case BinaryOpcode::Lt:
+      return Builder.CreateICmpSLT(L, R, "slttmp");
+    case BinaryOpcode::Le:
+      return Builder.CreateICmpSLE(L, R, "sletmp");
+    case BinaryOpcode::Ge:
+      return Builder.CreateICmpSGE(L, R, "sgetmp");
+    case BinaryOpcode::Gt:
+      return Builder.CreateICmpSGT(L, R, "sgttmp");
+    case BinaryOpcode::Eq:
+      return Builder.CreateICmpEQ(L, R, "eqtmp");
+    case BinaryOpcode::Ne:
+      return Builder.CreateICmpNE(L, R, "netmp");
+    case BinaryOpcode::And:
+      return Builder.CreateAnd(L, R, "andtmp");
+    case BinaryOpcode::Or:
+      return Builder.CreateOr(L, R, "ortmp");
+    }
+  }
+  llvm_unreachable("invalid binary operator");
+}
+
+// Builds Op on an operand of type OperandType
+static Value *createUnaryOp(UnaryOpcode Op, MiniCType OperandType,
+                            Value *Operand) {
+  // Check type of operand and make corresponding calls to generate IR code
+  switch (OperandType) {
+  case MiniCType::Float:
+    // Sema rejects ! on a float
+    return Builder.CreateFNeg(Operand, "negftmp");
+  case MiniCType::Int:
+    if (Op == UnaryOpcode::Neg) {
+      return Builder.CreateNeg(Operand, "negtmp");
+    } else {
+      return Builder.CreateNot(Operand, "nottmp");
+    }
+  case MiniCType::Bool:
+    if (Op == UnaryOpcode::Neg) {
+      return Builder.CreateNeg(Operand, "negftmp");
+    } else {
+      return Builder.CreateNot(Operand, "nottmp");
+    }
+  case MiniCType::Void:
+    break;
+  }
+  llvm_unreachable("Sema rejects a void operand");
+}
+
+// Converts Operand to To. Sema only converts between float and int or bool.
+static Value *createConversion(MiniCType To, Value *Operand) {
+  if (To == MiniCType::Float) {
+    return Builder.CreateSIToFP(Operand, getLLVMType(To), "convtmp");
+  }
+  return Builder.CreateFPToSI(Operand, getLLVMType(To), "convtmp");
+}
+
+// Declares function Name with the given parameters, leaving out the
+// placeholder parameter of "(void)", which takes no argument
+static Function *
+createFunction(SymbolID Name, MiniCType Type,
+               ArrayRef<std::pair<SymbolID, MiniCType>> Params) {
+  // Get types of all parameters
+  std::vector<llvm::Type *> params;
+  for (auto &Param : Params) {
+    if (Param.second != MiniCType::Void) {
+      params.push_back(getLLVMType(Param.second));
+    }
+  }
+
+  // Get return type of function
+  FunctionType *FT;
+  FT = FunctionType::get(getLLVMType(Type), params, false);
+  // Construct function given its FunctionType
+  Function *F = Function::Create(FT, Function::ExternalLinkage, Symbols.name(Name), TheModule.get());
+  FunctionValues[Name] = F;
+  // Set argument names
+  unsigned Idx = 0;
+  for (auto &Arg : F->args()) {
+    Arg.setName(Symbols.name(Params[Idx].first));
+    Idx++;
+  }
+
+  return F;
+}
+
+Value *BinaryASTnode::codegen(int block_index) {
+  // Generate IR code for LHS and RHS, converting an operand only once both
+  // are generated
+  auto *LCast = dyn_cast<CastASTnode>(LHS);
+  auto *RCast = dyn_cast<CastASTnode>(RHS);
+  Value *L = (LCast ? LCast->getOperand() : LHS)->codegen(block_index);
+  Value *R = (RCast ? RCast->getOperand() : RHS)->codegen(block_index);
+  if (LCast != nullptr) {
+    L = LCast->convert(L);
+  }
+  if (RCast != nullptr) {
+    R = RCast->convert(R);
+  }
+  return createBinaryOp(Op, LHS->getExprType(), L, R);
+}
+
+Value *UnaryASTnode::codegen(int block_index) {
+  // Generate IR code for operand and pass in block_index for correct scope
+  Value *Operand = Val->codegen(block_index);
+  return createUnaryOp(Op, Val->getExprType(), Operand);
+}
+
+Value *CastASTnode::codegen(int block_index) {
+  return convert(Val->codegen(block_index));
+}
+
+Value *CastASTnode::convert(Value *Operand) {
+  return createConversion(getExprType(), Operand);
+}
+
+Value *BlockASTnode::codegen(int block_index) {
+  // Loop through all declarations and statements and generate IR code
+  // Pass in block_index to each to allow further function calls to have access
+  // to the correct scope
+  Value *RetVal = nullptr;
+  for (auto &Decl : Declarations) {
+    RetVal = Decl->codegen(block_index);
+  }
+  for (auto &Stmt : Statements) {
+    RetVal = Stmt->codegen(block_index);
+  }
+  return RetVal;
+}
+
+Value *FunctionParamASTnode::codegen(int block_index) {
+  // This does not need to generate any IR
+  return nullptr;
+}
+
+Function *FunctionPrototypeASTnode::codegen(int block_index) {
+  SmallVector<std::pair<SymbolID, MiniCType>, 8> Params;
+  for (auto &Arg : Args) {
+    Params.emplace_back(Arg->getName(), Arg->getType());
+  }
+  return createFunction(Name, Type, Params);
+}
+
+Function *ExternASTnode::codegen(int block_index) {
+  // Exact same as PrototypeASTnode
+  SmallVector<std::pair<SymbolID, MiniCType>, 8> ParamList;
+  for (auto &Param : Params) {
+    ParamList.emplace_back(Param->getName(), Param->getType());
+  }
+  return createFunction(Name, Type, ParamList);
+}
+
+Function *FunctionDefASTnode::codegen(int block_index) {
+  // Make room for the allocas of the locals Sema found
+  LocalSlots.assign(NumSlots, nullptr);
+  auto declared = FunctionValues.find(Prototype->getName());
+  Function *TheFunction = declared != FunctionValues.end() ? declared->second : nullptr;
+  if (TheFunction == nullptr) {
+    // Generate IR code for function prototype
+    TheFunction = Prototype->codegen(block_index);
+  }
+  if (TheFunction == nullptr) {
     return nullptr;
   }
   // Create entry for function definition
@@ -2301,183 +3787,1395 @@ Function *FunctionDefASTnode::codegen(int block_index) {
   // Get passed in arguments to function and create alloca blocks for each
   int count = 0;
   for (auto &Arg: TheFunction->args()) {
-    std::string arg_type = Prototype->getArgType(count);
-    AllocaInst *Alloca = CreateEntryBlockAlloca(TheFunction, Arg.getName().data(), arg_type);
+    MiniCType arg_type = Prototype->getArgType(count);
+    AllocaInst *Alloca = CreateEntryBlockAlloca(TheFunction, Arg.getName(), arg_type);
     Builder.CreateStore(&Arg, Alloca);
-    NamedValuesArray[block_index][std::string(Arg.getName())] = Alloca;
+    LocalSlots[count] = Alloca;
     count = count + 1;
   }
-  // Check if there is a return value, if so create a non-void return, otherwise create
-  // a void return
-  Value *RetVal = Body->codegen(block_index);
-  if (RetVal) {
-    if (Prototype->getType() == "void") {
-      Builder.CreateRetVoid();
-    } else {
-      Builder.CreateRet(RetVal);
+  // Check if there is a return value, if so create a non-void return, otherwise create
+  // a void return
+  Value *RetVal = getBody()->codegen(block_index);
+  if (RetVal) {
+    if (Prototype->getType() == MiniCType::Void) {
+      Builder.CreateRetVoid();
+    } else {
+      Builder.CreateRet(RetVal);
+    }
+  }
+
+  verifyFunction(*TheFunction);
+  return TheFunction;
+}
+
+Value *CallASTnode::codegen(int block_index) {
+  // Look up function name in the table of declared functions, where Sema
+  // made sure it is
+  Function *CalleeF = FunctionValues.lookup(CallFunc);
+  // Generate IR code for each function argument and append to func_args array
+  std::vector<Value *> func_args;
+  for (unsigned i = 0, e = Args.size(); i != e; i++) {
+    func_args.push_back(Args[i]->codegen(block_index));
+  }
+  return Builder.CreateCall(CalleeF, func_args, "calltmp");
+}
+
+Value *IfExprASTnode::codegen(int block_index) {
+  Function *TheFunction = Builder.GetInsertBlock()->getParent();
+  BasicBlock *true_ = BasicBlock::Create(TheContext, "if then", TheFunction);
+  BasicBlock *else_ = BasicBlock::Create(TheContext, "else then");
+  BasicBlock *end_ = BasicBlock::Create(TheContext, "end");
+  // Generate condition for if statement
+  Value *cond = Cond->codegen(block_index);
+  Value *comp_int = ConstantInt::get(TheContext, APInt(1,0,false));
+  Value *comp = Builder.CreateICmpNE(cond, comp_int, "ifcond");
+  // Check if an else block exists
+  if (Else == nullptr) {
+    // Else block does not exist
+    // Branch to true if condition is true, end otherwise
+    Builder.CreateCondBr(comp, true_, end_);
+    // True starts here
+    Builder.SetInsertPoint(true_);
+    // Generate IR code for body
+    Then->codegen(block_index);
+    TheFunction->getBasicBlockList().push_back(end_);
+    // Unconditional branch to end
+    Builder.CreateBr(end_);
+    // End starts here
+    Builder.SetInsertPoint(end_);
+  } else {
+    // Else block does exist
+    // Branch to true if condition is true, else otherwise
+    Builder.CreateCondBr(comp, true_, else_);
+    // True starts here
+    Builder.SetInsertPoint(true_);
+    // Generate IR code for body
+    Then->codegen(block_index);
+    // Unconditional branch to end
+    Builder.CreateBr(end_);
+    TheFunction->getBasicBlockList().push_back(else_);
+    // Else starts here
+    Builder.SetInsertPoint(else_);
+    // Generate IR code for else body
+    Else->codegen(block_index);
+    TheFunction->getBasicBlockList().push_back(end_);
+    // Unconditional branch to end
+    Builder.CreateBr(end_);
+    // End starts here
+    Builder.SetInsertPoint(end_);
+  }
+  return nullptr;
+}
+
+Value *WhileExprASTnode::codegen(int block_index) {
+  Function *TheFunction = Builder.GetInsertBlock()->getParent();
+  BasicBlock *while_header = BasicBlock::Create(TheContext, "header", TheFunction);
+  BasicBlock *body_ = BasicBlock::Create(TheContext, "body");
+  BasicBlock *end_ = BasicBlock::Create(TheContext, "end");
+  // Start while header here
+  Builder.CreateBr(while_header);
+  Builder.SetInsertPoint(while_header);
+  // Generate condition for while loop
+  Value *cond = Cond->codegen(block_index);
+  Value *comp_int = ConstantInt::get(TheContext, APInt(1,0,false));
+  Value *comp = Builder.CreateICmpNE(cond, comp_int, "whilecond");
+  // Branch to body if condition is true, to end otherwise
+  Builder.CreateCondBr(comp, body_, end_);
+  TheFunction->getBasicBlockList().push_back(body_);
+  // Body starts here
+  Builder.SetInsertPoint(body_);
+  // Generate code for body
+  Then->codegen(block_index);
+  // Unconditional branch to while header for condition to be evaluated again
+  Builder.CreateBr(while_header);
+  TheFunction->getBasicBlockList().push_back(end_);
+  // Unconditional branch to end
+  Builder.CreateBr(end_);
+  // End starts here
+  Builder.SetInsertPoint(end_);
+  return nullptr;
+}
+
+Value *ReturnExprASTnode::codegen(int block_index) {
+  // Sema checked the return value against the function's type
+  if (ReturnValue == nullptr) {
+    // Return expression does not return a value, only pass control flow
+    return Builder.CreateRetVoid();
+  } else {
+    Builder.CreateRet(ReturnValue->codegen(block_index));
+    return nullptr;
+  }
+}
+
+Value *RootASTnode::codegen(int block_index) {
+  Value *RetVal;
+  Function *RetFunc;
+  // Call codegen on each extern and declaration
+  for (auto &Ext : Ext_List) {
+    RetFunc = Ext->codegen(block_index);
+  }
+  for (auto &Decl : Decl_List) {
+    RetVal = Decl->codegen(block_index);
+  }
+  return RetFunc;
+}
+
+//===----------------------------------------------------------------------===//
+// AST Printer
+//===----------------------------------------------------------------------===//
+
+/// ASTPrinter - writes the tree to a raw_ostream as it walks it, one node
+/// per line with " |-" per level of nesting. The prefix is a single buffer
+/// that grows and shrinks with the depth, so nothing is built up per node.
+class ASTPrinter : public ASTVisitor<ASTPrinter> {
+  raw_ostream &OS;
+  SmallString<128> Indent;
+
+  // Visits N one level deeper than the current node
+  void visitChild(ASTnode *N) {
+    size_t Depth = Indent.size();
+    Indent += " |-";
+    visit(N);
+    Indent.resize(Depth);
+  }
+
+public:
+  ASTPrinter(raw_ostream &OS) : OS(OS) {}
+
+  void visitInt(IntASTnode *N) { OS << Indent << N->getVal(); }
+  // Printed as std::ostream would by default, with 6 significant digits
+  void visitFloat(FloatASTnode *N) { OS << Indent << format("%g", N->getVal()); }
+  void visitBool(BoolASTnode *N) { OS << Indent << (N->getVal() ? "1" : "0"); }
+  void visitVariable(VariableASTnode *N) { OS << Indent << Symbols.name(N->getName()); }
+
+  void visitVariableAssignment(VariableAssignmentASTnode *N) {
+    OS << Indent << "Assigned identifier \n";
+    visitChild(N->getVariable());
+    OS << "\n";
+    visitChild(N->getVal());
+  }
+
+  void visitVariableDeclaration(VariableDeclarationASTnode *N) {
+    OS << Indent << "Declared " << typeName(N->getType()) << " "
+       << Symbols.name(N->getName());
+  }
+
+  void visitBlock(BlockASTnode *N) {
+    OS << Indent << "Block";
+    for (auto &Decl : N->getDeclarations()) {
+      OS << "\n";
+      visitChild(Decl);
+    }
+    for (auto &Stmt : N->getStatements()) {
+      OS << "\n";
+      visitChild(Stmt);
+    }
+  }
+
+  void visitBinary(BinaryASTnode *N) {
+    OS << Indent << "Binary operation\n";
+    visitChild(N->getLHS());
+    OS << "\n" << Indent << " |-" << opSpelling(N->getOp()) << "\n";
+    visitChild(N->getRHS());
+  }
+
+  void visitUnary(UnaryASTnode *N) {
+    OS << Indent << "Unary operation of " << opSpelling(N->getOp());
+    visitChild(N->getOperand());
+  }
+
+  void visitCast(CastASTnode *N) {
+    OS << Indent << "Conversion to " << typeName(N->getExprType()) << "\n";
+    visitChild(N->getOperand());
+  }
+
+  void visitCall(CallASTnode *N) {
+    OS << Indent << "Calling function " << Symbols.name(N->getCallee())
+       << " with arguments ";
+    for (auto &Arg : N->getArgs()) {
+      OS << "\n";
+      visitChild(Arg);
+    }
+  }
+
+  void visitFunctionParam(FunctionParamASTnode *N) {
+    // The placeholder parameter of "(void)" has always been dumped as VOID
+    MiniCType Type = N->getType();
+    OS << "\n" << Indent << "Function parameter "
+       << (Type == MiniCType::Void ? "VOID" : typeName(Type)) << " "
+       << Symbols.name(N->getName());
+  }
+
+  void visitFunctionPrototype(FunctionPrototypeASTnode *N) {
+    OS << Indent << "Function Prototype " << typeName(N->getType()) << " "
+       << Symbols.name(N->getName()) << " with parameters ";
+    for (auto &Arg : N->getArgs())
+      visitChild(Arg);
+  }
+
+  void visitFunctionDef(FunctionDefASTnode *N) {
+    OS << Indent << "Function Definition \n";
+    visitChild(N->getPrototype());
+    OS << "\n";
+    visitChild(N->getBody());
+  }
+
+  void visitExtern(ExternASTnode *N) {
+    OS << Indent << "Extern " << typeName(N->getType()) << " "
+       << Symbols.name(N->getName()) << " with parameters";
+    for (auto &Param : N->getParams())
+      visitChild(Param);
+    OS << "\n";
+  }
+
+  void visitIfExpr(IfExprASTnode *N) {
+    OS << Indent << "If \n";
+    visitChild(N->getCond());
+    OS << "\n";
+    visitChild(N->getThen());
+    if (N->getElse() != nullptr) {
+      OS << "\n";
+      visitChild(N->getElse());
+    }
+  }
+
+  void visitWhileExpr(WhileExprASTnode *N) {
+    OS << Indent << "While \n";
+    visitChild(N->getCond());
+    OS << "\n";
+    visitChild(N->getBody());
+  }
+
+  void visitReturnExpr(ReturnExprASTnode *N) {
+    OS << Indent << "Return expression";
+    if (N->getReturnValue() != nullptr) {
+      OS << "\n";
+      visitChild(N->getReturnValue());
+    }
+  }
+
+  void visitRoot(RootASTnode *N) {
+    OS << Indent << "Program root \n";
+    for (auto &Ext : N->getExterns())
+      visitChild(Ext);
+    for (auto &Decl : N->getDecls())
+      visitChild(Decl);
+  }
+};
+
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os, ASTnode &ast) {
+  ASTPrinter(os).visit(&ast);
+  return os;
+}
+
+//===----------------------------------------------------------------------===//
+// Flat AST
+//===----------------------------------------------------------------------===//
+
+/// FlatAST - a program laid out flat (--flat-ast). Every node is a 16-byte Node
+/// in one array, in the order a walk of the tree reaches them, and refers to
+/// its children by 32-bit index. A list of children is a run of indices in a
+/// second array. No payload needs a table of its own: names are SymbolIDs and
+/// slots, and every literal fits in 32 bits.
+///
+/// The tree is still what the parser builds and what Sema, the simplifier and
+/// the AST cache rewrite in place; the flat form is lowered from it once they
+/// are done, and codegen and the printer walk it by switching over the kind.
+///
+///   Kind                 A                B               C
+///   Int, Float, Bool     value bits
+///   Variable             name             slot
+///   VariableAssignment   variable         value
+///   VariableDeclaration  name             slot
+///   Block                first in Lists   declarations    statements
+///   Binary, Unary, Cast  operand (LHS)    RHS
+///   Call                 callee           first in Lists  arguments
+///   FunctionParam        name
+///   FunctionPrototype    name             first in Lists  parameters
+///   FunctionDef          prototype        body            slots
+///   Extern               name             first in Lists  parameters
+///   IfExpr               condition        then            else or NoNode
+///   WhileExpr            condition        body
+///   ReturnExpr           value or NoNode
+///   Root                 first in Lists   externs         declarations
+///
+/// Type is the type of an expression, the declared type of a variable or
+/// parameter, or the return type of a function. Op is the opcode of a Binary
+/// or Unary.
+class FlatAST {
+public:
+  static constexpr uint32_t NoNode = UINT32_MAX;
+
+  struct Node {
+    ASTnode::NodeKind Kind;
+    MiniCType Type;
+    uint8_t Op;
+    uint32_t A = 0, B = 0, C = 0;
+  };
+  static_assert(sizeof(Node) == 16, "flat nodes are meant to stay small");
+
+private:
+  std::vector<Node> Nodes;
+  std::vector<uint32_t> Lists;
+  uint32_t Root;
+
+  friend class FlatBuilder;
+
+public:
+  explicit FlatAST(RootASTnode *Program);
+
+  uint32_t getRoot() const { return Root; }
+  const Node &operator[](uint32_t Index) const { return Nodes[Index]; }
+  // The Count children of a list starting at First
+  ArrayRef<uint32_t> list(uint32_t First, uint32_t Count) const {
+    return makeArrayRef(Lists).slice(First, Count);
+  }
+  size_t getBytes() const {
+    return Nodes.size() * sizeof(Node) + Lists.size() * sizeof(uint32_t);
+  }
+};
+
+/// FlatBuilder - lowers a tree into a FlatAST. A node is added before its
+/// children, so a walk that goes down the tree goes forward through the array.
+class FlatBuilder : public ASTVisitor<FlatBuilder, uint32_t> {
+  std::vector<FlatAST::Node> &Nodes;
+  std::vector<uint32_t> &Lists;
+
+  uint32_t add(ASTnode *N, MiniCType Type, uint8_t Op = 0) {
+    Nodes.push_back({N->getKind(), Type, Op});
+    return Nodes.size() - 1;
+  }
+
+  // Lowers the non-null nodes of each list in Elems and stores their indices
+  // as one run, returning where it starts and how many there are of each
+  template <typename... Ts>
+  std::pair<uint32_t, std::array<uint32_t, sizeof...(Ts)>>
+  list(ArrayRef<Ts *>... Elems) {
+    SmallVector<uint32_t, 16> Indices;
+    std::array<uint32_t, sizeof...(Ts)> Counts{};
+    size_t Which = 0;
+    auto Lower = [&](auto List) {
+      for (auto *Elem : List) {
+        if (Elem != nullptr) {
+          Indices.push_back(visit(Elem));
+          Counts[Which]++;
+        }
+      }
+      Which++;
+    };
+    (Lower(Elems), ...);
+    uint32_t First = Lists.size();
+    Lists.insert(Lists.end(), Indices.begin(), Indices.end());
+    return {First, Counts};
+  }
+
+  uint32_t child(ASTnode *N) { return N != nullptr ? visit(N) : FlatAST::NoNode; }
+
+public:
+  FlatBuilder(FlatAST &F) : Nodes(F.Nodes), Lists(F.Lists) {}
+
+  uint32_t visitInt(IntASTnode *N) {
+    uint32_t I = add(N, MiniCType::Int);
+    Nodes[I].A = static_cast<uint32_t>(N->getVal());
+    return I;
+  }
+  uint32_t visitFloat(FloatASTnode *N) {
+    uint32_t I = add(N, MiniCType::Float);
+    Nodes[I].A = FloatToBits(N->getVal());
+    return I;
+  }
+  uint32_t visitBool(BoolASTnode *N) {
+    uint32_t I = add(N, MiniCType::Bool);
+    Nodes[I].A = N->getVal();
+    return I;
+  }
+  uint32_t visitVariable(VariableASTnode *N) {
+    uint32_t I = add(N, N->getExprType());
+    Nodes[I].A = N->getName();
+    Nodes[I].B = N->getSlot();
+    return I;
+  }
+  uint32_t visitVariableAssignment(VariableAssignmentASTnode *N) {
+    uint32_t I = add(N, N->getExprType());
+    uint32_t Var = visit(N->getVariable());
+    uint32_t Val = visit(N->getVal());
+    Nodes[I].A = Var;
+    Nodes[I].B = Val;
+    return I;
+  }
+  uint32_t visitVariableDeclaration(VariableDeclarationASTnode *N) {
+    uint32_t I = add(N, N->getType());
+    Nodes[I].A = N->getName();
+    Nodes[I].B = N->getSlot();
+    return I;
+  }
+  uint32_t visitBlock(BlockASTnode *N) {
+    uint32_t I = add(N, MiniCType::Void);
+    auto Run = list(N->getDeclarations(), N->getStatements());
+    Nodes[I].A = Run.first;
+    Nodes[I].B = Run.second[0];
+    Nodes[I].C = Run.second[1];
+    return I;
+  }
+  uint32_t visitBinary(BinaryASTnode *N) {
+    uint32_t I = add(N, N->getExprType(), static_cast<uint8_t>(N->getOp()));
+    uint32_t LHS = visit(N->getLHS());
+    uint32_t RHS = visit(N->getRHS());
+    Nodes[I].A = LHS;
+    Nodes[I].B = RHS;
+    return I;
+  }
+  uint32_t visitUnary(UnaryASTnode *N) {
+    uint32_t I = add(N, N->getExprType(), static_cast<uint8_t>(N->getOp()));
+    uint32_t Operand = visit(N->getOperand());
+    Nodes[I].A = Operand;
+    return I;
+  }
+  uint32_t visitCast(CastASTnode *N) {
+    uint32_t I = add(N, N->getExprType());
+    uint32_t Operand = visit(N->getOperand());
+    Nodes[I].A = Operand;
+    return I;
+  }
+  uint32_t visitCall(CallASTnode *N) {
+    uint32_t I = add(N, N->getExprType());
+    auto Run = list(N->getArgs());
+    Nodes[I].A = N->getCallee();
+    Nodes[I].B = Run.first;
+    Nodes[I].C = Run.second[0];
+    return I;
+  }
+  uint32_t visitFunctionParam(FunctionParamASTnode *N) {
+    uint32_t I = add(N, N->getType());
+    Nodes[I].A = N->getName();
+    return I;
+  }
+  uint32_t visitFunctionPrototype(FunctionPrototypeASTnode *N) {
+    uint32_t I = add(N, N->getType());
+    auto Run = list(N->getArgs());
+    Nodes[I].A = N->getName();
+    Nodes[I].B = Run.first;
+    Nodes[I].C = Run.second[0];
+    return I;
+  }
+  uint32_t visitFunctionDef(FunctionDefASTnode *N) {
+    uint32_t I = add(N, N->getPrototype()->getType());
+    uint32_t Proto = visit(N->getPrototype());
+    uint32_t Body = visit(N->getBody());
+    Nodes[I].A = Proto;
+    Nodes[I].B = Body;
+    Nodes[I].C = N->getNumSlots();
+    return I;
+  }
+  uint32_t visitExtern(ExternASTnode *N) {
+    uint32_t I = add(N, N->getType());
+    auto Run = list(N->getParams());
+    Nodes[I].A = N->getName();
+    Nodes[I].B = Run.first;
+    Nodes[I].C = Run.second[0];
+    return I;
+  }
+  uint32_t visitIfExpr(IfExprASTnode *N) {
+    uint32_t I = add(N, MiniCType::Void);
+    uint32_t Cond = visit(N->getCond());
+    uint32_t Then = visit(N->getThen());
+    uint32_t Else = child(N->getElse());
+    Nodes[I].A = Cond;
+    Nodes[I].B = Then;
+    Nodes[I].C = Else;
+    return I;
+  }
+  uint32_t visitWhileExpr(WhileExprASTnode *N) {
+    uint32_t I = add(N, MiniCType::Void);
+    uint32_t Cond = visit(N->getCond());
+    uint32_t Body = visit(N->getBody());
+    Nodes[I].A = Cond;
+    Nodes[I].B = Body;
+    return I;
+  }
+  uint32_t visitReturnExpr(ReturnExprASTnode *N) {
+    uint32_t I = add(N, MiniCType::Void);
+    uint32_t Value = child(N->getReturnValue());
+    Nodes[I].A = Value;
+    return I;
+  }
+  uint32_t visitRoot(RootASTnode *N) {
+    uint32_t I = add(N, MiniCType::Void);
+    auto Run = list(N->getExterns(), N->getDecls());
+    Nodes[I].A = Run.first;
+    Nodes[I].B = Run.second[0];
+    Nodes[I].C = Run.second[1];
+    return I;
+  }
+};
+
+FlatAST::FlatAST(RootASTnode *Program) {
+  Root = FlatBuilder(*this).visit(Program);
+}
+
+/// FlatPrinter - writes a FlatAST in the same format as ASTPrinter
+class FlatPrinter {
+  const FlatAST &F;
+  raw_ostream &OS;
+  SmallString<128> Indent;
+
+  // Prints node I one level deeper than the current node
+  void printChild(uint32_t I) {
+    size_t Depth = Indent.size();
+    Indent += " |-";
+    print(I);
+    Indent.resize(Depth);
+  }
+
+public:
+  FlatPrinter(const FlatAST &F, raw_ostream &OS) : F(F), OS(OS) {}
+
+  void print(uint32_t I) {
+    const FlatAST::Node &N = F[I];
+    switch (N.Kind) {
+    case ASTnode::NK_Int:
+      OS << Indent << static_cast<int>(N.A);
+      return;
+    case ASTnode::NK_Float:
+      // Printed as std::ostream would by default, with 6 significant digits
+      OS << Indent << format("%g", BitsToFloat(N.A));
+      return;
+    case ASTnode::NK_Bool:
+      OS << Indent << (N.A ? "1" : "0");
+      return;
+    case ASTnode::NK_Variable:
+      OS << Indent << Symbols.name(N.A);
+      return;
+    case ASTnode::NK_VariableAssignment:
+      OS << Indent << "Assigned identifier \n";
+      printChild(N.A);
+      OS << "\n";
+      printChild(N.B);
+      return;
+    case ASTnode::NK_VariableDeclaration:
+      OS << Indent << "Declared " << typeName(N.Type) << " "
+         << Symbols.name(N.A);
+      return;
+    case ASTnode::NK_Block:
+      OS << Indent << "Block";
+      for (uint32_t Child : F.list(N.A, N.B + N.C)) {
+        OS << "\n";
+        printChild(Child);
+      }
+      return;
+    case ASTnode::NK_Binary:
+      OS << Indent << "Binary operation\n";
+      printChild(N.A);
+      OS << "\n" << Indent << " |-"
+         << opSpelling(static_cast<BinaryOpcode>(N.Op)) << "\n";
+      printChild(N.B);
+      return;
+    case ASTnode::NK_Unary:
+      OS << Indent << "Unary operation of "
+         << opSpelling(static_cast<UnaryOpcode>(N.Op));
+      printChild(N.A);
+      return;
+    case ASTnode::NK_Cast:
+      OS << Indent << "Conversion to " << typeName(N.Type) << "\n";
+      printChild(N.A);
+      return;
+    case ASTnode::NK_Call:
+      OS << Indent << "Calling function " << Symbols.name(N.A)
+         << " with arguments ";
+      for (uint32_t Arg : F.list(N.B, N.C)) {
+        OS << "\n";
+        printChild(Arg);
+      }
+      return;
+    case ASTnode::NK_FunctionParam:
+      // The placeholder parameter of "(void)" has always been dumped as VOID
+      OS << "\n" << Indent << "Function parameter "
+         << (N.Type == MiniCType::Void ? "VOID" : typeName(N.Type)) << " "
+         << Symbols.name(N.A);
+      return;
+    case ASTnode::NK_FunctionPrototype:
+      OS << Indent << "Function Prototype " << typeName(N.Type) << " "
+         << Symbols.name(N.A) << " with parameters ";
+      for (uint32_t Arg : F.list(N.B, N.C))
+        printChild(Arg);
+      return;
+    case ASTnode::NK_FunctionDef:
+      OS << Indent << "Function Definition \n";
+      printChild(N.A);
+      OS << "\n";
+      printChild(N.B);
+      return;
+    case ASTnode::NK_Extern:
+      OS << Indent << "Extern " << typeName(N.Type) << " " << Symbols.name(N.A)
+         << " with parameters";
+      for (uint32_t Param : F.list(N.B, N.C))
+        printChild(Param);
+      OS << "\n";
+      return;
+    case ASTnode::NK_IfExpr:
+      OS << Indent << "If \n";
+      printChild(N.A);
+      OS << "\n";
+      printChild(N.B);
+      if (N.C != FlatAST::NoNode) {
+        OS << "\n";
+        printChild(N.C);
+      }
+      return;
+    case ASTnode::NK_WhileExpr:
+      OS << Indent << "While \n";
+      printChild(N.A);
+      OS << "\n";
+      printChild(N.B);
+      return;
+    case ASTnode::NK_ReturnExpr:
+      OS << Indent << "Return expression";
+      if (N.A != FlatAST::NoNode) {
+        OS << "\n";
+        printChild(N.A);
+      }
+      return;
+    case ASTnode::NK_Root:
+      OS << Indent << "Program root \n";
+      for (uint32_t Decl : F.list(N.A, N.B + N.C))
+        printChild(Decl);
+      return;
     }
+    llvm_unreachable("unknown AST node kind");
   }
+};
 
-  verifyFunction(*TheFunction);
-  return TheFunction;
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const FlatAST &F) {
+  FlatPrinter(F, os).print(F.getRoot());
+  return os;
 }
 
-Value *CallASTnode::codegen(int block_index) {
-  // Look up function name in the global module table
-  Function *CalleeF = TheModule->getFunction(CallFunc);
-  if (CalleeF == nullptr) {
-    throw LogErrorV("Semantic Error: Undefined function referenced " + CallFunc);
+/// FlatCodegen - builds the IR of a FlatAST into TheModule. Each case builds
+/// exactly what codegen of the matching tree node does, so the two layouts
+/// give the same module.
+class FlatCodegen {
+  const FlatAST &F;
+
+  // Parameters of a prototype or extern, in the form createFunction takes
+  SmallVector<std::pair<SymbolID, MiniCType>, 8>
+  params(const FlatAST::Node &N) {
+    SmallVector<std::pair<SymbolID, MiniCType>, 8> Params;
+    for (uint32_t Param : F.list(N.B, N.C))
+      Params.emplace_back(F[Param].A, F[Param].Type);
+    return Params;
   }
-  // Check if number of arguments is correct
-  if (CalleeF->arg_size() != Args.size()){
-    throw LogErrorV("Semantic Error: Incorrect number of arguments passed into function, expected " + 
-    std::to_string(CalleeF->arg_size()) + " but got " + std::to_string(Args.size()));
+
+  Value *emitFunctionDef(const FlatAST::Node &N) {
+    const FlatAST::Node &Proto = F[N.A];
+    // Make room for the allocas of the locals Sema found
+    LocalSlots.assign(N.C, nullptr);
+    Function *TheFunction = FunctionValues.lookup(Proto.A);
+    if (TheFunction == nullptr) {
+      TheFunction = createFunction(Proto.A, Proto.Type, params(Proto));
+    }
+    BasicBlock *BB = BasicBlock::Create(TheContext, "entry", TheFunction);
+    Builder.SetInsertPoint(BB);
+
+    // Parameter i is slot i
+    ArrayRef<uint32_t> Params = F.list(Proto.B, Proto.C);
+    unsigned Count = 0;
+    for (auto &Arg : TheFunction->args()) {
+      AllocaInst *Alloca = CreateEntryBlockAlloca(TheFunction, Arg.getName(),
+                                                  F[Params[Count]].Type);
+      Builder.CreateStore(&Arg, Alloca);
+      LocalSlots[Count] = Alloca;
+      Count++;
+    }
+    // The last statement of the body decides whether a return is added, as in
+    // FunctionDefASTnode::codegen
+    Value *RetVal = emit(N.B);
+    if (RetVal) {
+      if (Proto.Type == MiniCType::Void) {
+        Builder.CreateRetVoid();
+      } else {
+        Builder.CreateRet(RetVal);
+      }
+    }
+
+    verifyFunction(*TheFunction);
+    return TheFunction;
   }
-  // Generate IR code for each function argument and append to func_args array
-  std::vector<Value *> func_args;
-  for (unsigned i = 0, e = Args.size(); i != e; i++) {
-    func_args.push_back(Args[i]->codegen(block_index));
-    if (func_args.back() == nullptr) {
-      return nullptr;
+
+  Value *emitIfExpr(const FlatAST::Node &N) {
+    Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    BasicBlock *true_ = BasicBlock::Create(TheContext, "if then", TheFunction);
+    BasicBlock *else_ = BasicBlock::Create(TheContext, "else then");
+    BasicBlock *end_ = BasicBlock::Create(TheContext, "end");
+    Value *cond = emit(N.A);
+    Value *comp_int = ConstantInt::get(TheContext, APInt(1, 0, false));
+    Value *comp = Builder.CreateICmpNE(cond, comp_int, "ifcond");
+    if (N.C == FlatAST::NoNode) {
+      Builder.CreateCondBr(comp, true_, end_);
+      Builder.SetInsertPoint(true_);
+      emit(N.B);
+      TheFunction->getBasicBlockList().push_back(end_);
+      Builder.CreateBr(end_);
+      Builder.SetInsertPoint(end_);
+    } else {
+      Builder.CreateCondBr(comp, true_, else_);
+      Builder.SetInsertPoint(true_);
+      emit(N.B);
+      Builder.CreateBr(end_);
+      TheFunction->getBasicBlockList().push_back(else_);
+      Builder.SetInsertPoint(else_);
+      emit(N.C);
+      TheFunction->getBasicBlockList().push_back(end_);
+      Builder.CreateBr(end_);
+      Builder.SetInsertPoint(end_);
     }
+    return nullptr;
   }
-  return Builder.CreateCall(CalleeF, func_args, "calltmp");
-}
 
-Value *IfExprASTnode::codegen(int block_index) {
-  // Increment block_index by one so next calls to codegen use correct local scope
-  block_index = block_index + 1;
-  // Create new local variable table
-  std::map<std::string, AllocaInst *> NamedValues;
-  // Push new table into array
-  NamedValuesArray.push_back(NamedValues);
-  Function *TheFunction = Builder.GetInsertBlock()->getParent();
-  BasicBlock *true_ = BasicBlock::Create(TheContext, "if then", TheFunction);
-  BasicBlock *else_ = BasicBlock::Create(TheContext, "else then");
-  BasicBlock *end_ = BasicBlock::Create(TheContext, "end");
-  // Generate condition for if statement
-  Value *cond = Cond->codegen(block_index);
-  Value *comp_int = ConstantInt::get(TheContext, APInt(1,0,false));
-  Value *comp = Builder.CreateICmpNE(cond, comp_int, "ifcond");
-  // Check if an else block exists
-  if (Else == nullptr) {
-    // Else block does not exist
-    // Branch to true if condition is true, end otherwise
-    Builder.CreateCondBr(comp, true_, end_);
-    // True starts here
-    Builder.SetInsertPoint(true_);
-    // Generate IR code for body
-    Then->codegen(block_index);
-    TheFunction->getBasicBlockList().push_back(end_);
-    // Unconditional branch to end
-    Builder.CreateBr(end_);
-    // End starts here
-    Builder.SetInsertPoint(end_);
-  } else {
-    // Else block does exist
-    // Branch to true if condition is true, else otherwise
-    Builder.CreateCondBr(comp, true_, else_);
-    // True starts here
-    Builder.SetInsertPoint(true_);
-    // Generate IR code for body
-    Then->codegen(block_index);
-    // Unconditional branch to end
-    Builder.CreateBr(end_);
-    TheFunction->getBasicBlockList().push_back(else_);
-    // Else starts here
-    Builder.SetInsertPoint(else_);
-    // Generate IR code for else body
-    Else->codegen(block_index);
+  Value *emitWhileExpr(const FlatAST::Node &N) {
+    Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    BasicBlock *while_header = BasicBlock::Create(TheContext, "header", TheFunction);
+    BasicBlock *body_ = BasicBlock::Create(TheContext, "body");
+    BasicBlock *end_ = BasicBlock::Create(TheContext, "end");
+    Builder.CreateBr(while_header);
+    Builder.SetInsertPoint(while_header);
+    Value *cond = emit(N.A);
+    Value *comp_int = ConstantInt::get(TheContext, APInt(1, 0, false));
+    Value *comp = Builder.CreateICmpNE(cond, comp_int, "whilecond");
+    Builder.CreateCondBr(comp, body_, end_);
+    TheFunction->getBasicBlockList().push_back(body_);
+    Builder.SetInsertPoint(body_);
+    emit(N.B);
+    Builder.CreateBr(while_header);
     TheFunction->getBasicBlockList().push_back(end_);
-    // Unconditional branch to end
     Builder.CreateBr(end_);
-    // End starts here
     Builder.SetInsertPoint(end_);
+    return nullptr;
   }
-  // Erase the local variables table for this if statement and all tables formed as part of this if block
-  // e.g. erase any blocks formed by nested if statements or while loops
-  NamedValuesArray.erase(NamedValuesArray.begin()+block_index, NamedValuesArray.end());
-  return nullptr;
+
+  // Stores Val to the variable node Var
+  void store(const FlatAST::Node &Var, Value *Val) {
+    if (Var.B == NonLocalSlot) {
+      Builder.CreateStore(Val, GlobalValues.lookup(Var.A));
+    } else {
+      Builder.CreateStore(Val, LocalSlots[Var.B]);
+    }
+  }
+
+public:
+  FlatCodegen(const FlatAST &F) : F(F) {}
+
+  Value *emit(uint32_t I) {
+    const FlatAST::Node &N = F[I];
+    switch (N.Kind) {
+    case ASTnode::NK_Int:
+      return ConstantInt::get(TheContext, APInt(32, static_cast<int>(N.A), true));
+    case ASTnode::NK_Float:
+      return ConstantFP::get(TheContext, APFloat(BitsToFloat(N.A)));
+    case ASTnode::NK_Bool:
+      return ConstantInt::get(TheContext, APInt(1, N.A, false));
+    case ASTnode::NK_Variable:
+      if (N.B == NonLocalSlot) {
+        return Builder.CreateLoad(getLLVMType(N.Type), GlobalValues.lookup(N.A),
+                                  Symbols.name(N.A));
+      } else {
+        AllocaInst *A = LocalSlots[N.B];
+        return Builder.CreateLoad(A->getAllocatedType(), A, Symbols.name(N.A));
+      }
+    case ASTnode::NK_VariableAssignment: {
+      Value *Val = emit(N.B);
+      store(F[N.A], Val);
+      return Val;
+    }
+    case ASTnode::NK_VariableDeclaration:
+      // Only locals are declared inside a function; globals are emitted by
+      // the Root case
+      LocalSlots[N.B] = CreateEntryBlockAlloca(
+          Builder.GetInsertBlock()->getParent(), Symbols.name(N.A), N.Type);
+      return nullptr;
+    case ASTnode::NK_Block: {
+      Value *RetVal = nullptr;
+      for (uint32_t Child : F.list(N.A, N.B + N.C))
+        RetVal = emit(Child);
+      return RetVal;
+    }
+    case ASTnode::NK_Binary: {
+      // A converted operand is converted only once both are generated
+      const FlatAST::Node &LHS = F[N.A], &RHS = F[N.B];
+      bool LCast = LHS.Kind == ASTnode::NK_Cast;
+      bool RCast = RHS.Kind == ASTnode::NK_Cast;
+      Value *L = emit(LCast ? LHS.A : N.A);
+      Value *R = emit(RCast ? RHS.A : N.B);
+      if (LCast)
+        L = createConversion(LHS.Type, L);
+      if (RCast)
+        R = createConversion(RHS.Type, R);
+      return createBinaryOp(static_cast<BinaryOpcode>(N.Op), LHS.Type, L, R);
+    }
+    case ASTnode::NK_Unary:
+      return createUnaryOp(static_cast<UnaryOpcode>(N.Op), F[N.A].Type,
+                           emit(N.A));
+    case ASTnode::NK_Cast:
+      return createConversion(N.Type, emit(N.A));
+    case ASTnode::NK_Call: {
+      Function *CalleeF = FunctionValues.lookup(N.A);
+      std::vector<Value *> Args;
+      for (uint32_t Arg : F.list(N.B, N.C))
+        Args.push_back(emit(Arg));
+      return Builder.CreateCall(CalleeF, Args, "calltmp");
+    }
+    case ASTnode::NK_FunctionParam:
+      return nullptr;
+    case ASTnode::NK_FunctionPrototype:
+    case ASTnode::NK_Extern:
+      return createFunction(N.A, N.Type, params(N));
+    case ASTnode::NK_FunctionDef:
+      return emitFunctionDef(N);
+    case ASTnode::NK_IfExpr:
+      return emitIfExpr(N);
+    case ASTnode::NK_WhileExpr:
+      return emitWhileExpr(N);
+    case ASTnode::NK_ReturnExpr:
+      if (N.A == FlatAST::NoNode) {
+        return Builder.CreateRetVoid();
+      }
+      Builder.CreateRet(emit(N.A));
+      return nullptr;
+    case ASTnode::NK_Root:
+      for (uint32_t Decl : F.list(N.A, N.B + N.C)) {
+        const FlatAST::Node &D = F[Decl];
+        if (D.Kind != ASTnode::NK_VariableDeclaration) {
+          emit(Decl);
+          continue;
+        }
+        llvm::Type *var_type = getLLVMType(D.Type);
+        GlobalVariable *g = new GlobalVariable(
+            *TheModule, var_type, false, GlobalValue::CommonLinkage,
+            Constant::getNullValue(var_type), Symbols.name(D.A));
+        g->setAlignment(MaybeAlign(4));
+        GlobalValues[D.A] = g;
+      }
+      return nullptr;
+    }
+    llvm_unreachable("unknown AST node kind");
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// AST cache
+//===----------------------------------------------------------------------===//
+
+// With --ast-cache the tree of Foo.c is saved to Foo.c.astc, keyed by a hash
+// of the source. A later compile of the same source maps the file and skips
+// lexing and parsing. After an edit, the file is parsed again but every
+// top-level declaration whose text is unchanged is taken from the cache; the
+// file keeps the hash of each one's text for this.
+//
+// The file is the tree's own memory image. Every node is stored as the object
+// the parser would have built, except that child pointers hold file offsets
+// and SymbolIDs index the file's own list of names. Loading maps the file copy-on-write and
+// rebuilds each node in place with real pointers and this process's IDs. The
+// layout is that of this build, so the header records the node sizes and a
+// cache from a different build is ignored.
+
+struct ASTCacheHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t LayoutHash;  // Mixes the sizes of the node classes
+  uint64_t SourceHash;  // xxHash64 of the source
+  uint64_t FileSize;
+  uint64_t RootOffset;
+  uint64_t SymbolsOffset; // Names as (uint32_t length, bytes), by SymbolID
+  uint64_t HashesOffset;  // Parser::getDeclHashes() of the tree
+  uint32_t NumSymbols;
+  uint32_t NumHashes;
+};
+
+static constexpr char ASTCacheMagic[8] = {'M', 'C', 'A', 'S', 'T', 'C', 0, 0};
+static constexpr uint32_t ASTCacheVersion = 3;
+
+// Size of a node of each kind, 0 for an invalid kind
+static size_t astNodeSize(ASTnode::NodeKind Kind) {
+  static const size_t Sizes[] = {
+      sizeof(IntASTnode),           sizeof(FloatASTnode),
+      sizeof(BoolASTnode),          sizeof(VariableASTnode),
+      sizeof(VariableAssignmentASTnode), sizeof(VariableDeclarationASTnode),
+      sizeof(BlockASTnode),         sizeof(BinaryASTnode),
+      sizeof(UnaryASTnode),         sizeof(CastASTnode),
+      sizeof(CallASTnode),
+      sizeof(FunctionParamASTnode), sizeof(FunctionPrototypeASTnode),
+      sizeof(FunctionDefASTnode),   sizeof(ExternASTnode),
+      sizeof(IfExprASTnode),        sizeof(WhileExprASTnode),
+      sizeof(ReturnExprASTnode),    sizeof(RootASTnode)};
+  return Kind <= ASTnode::NK_Root ? Sizes[Kind] : 0;
 }
 
-Value *WhileExprASTnode::codegen(int block_index) {
-  // Increment block_index by one so next calls to codegen use correct local scope
-  block_index = block_index + 1;
-  // Create new local variable table
-  std::map<std::string, AllocaInst *> NamedValues;
-  // Push new table into array
-  NamedValuesArray.push_back(NamedValues);
-  Function *TheFunction = Builder.GetInsertBlock()->getParent();
-  BasicBlock *while_header = BasicBlock::Create(TheContext, "header", TheFunction);
-  BasicBlock *body_ = BasicBlock::Create(TheContext, "body");
-  BasicBlock *end_ = BasicBlock::Create(TheContext, "end");
-  // Start while header here
-  Builder.CreateBr(while_header);
-  Builder.SetInsertPoint(while_header);
-  // Generate condition for while loop
-  Value *cond = Cond->codegen(block_index);
-  Value *comp_int = ConstantInt::get(TheContext, APInt(1,0,false));
-  Value *comp = Builder.CreateICmpNE(cond, comp_int, "whilecond");
-  // Branch to body if condition is true, to end otherwise
-  Builder.CreateCondBr(comp, body_, end_);
-  TheFunction->getBasicBlockList().push_back(body_);
-  // Body starts here
-  Builder.SetInsertPoint(body_);
-  // Generate code for body
-  Then->codegen(block_index);
-  // Unconditional branch to while header for condition to be evaluated again
-  Builder.CreateBr(while_header);
-  TheFunction->getBasicBlockList().push_back(end_);
-  // Unconditional branch to end
-  Builder.CreateBr(end_);
-  // End starts here
-  Builder.SetInsertPoint(end_);
-  return nullptr;
+static uint32_t astLayoutHash() {
+  uint32_t Hash = sizeof(void *);
+  for (unsigned Kind = 0; Kind <= ASTnode::NK_Root; Kind++)
+    Hash = Hash * 31 + astNodeSize(ASTnode::NodeKind(Kind));
+  return Hash;
 }
 
-Value *ReturnExprASTnode::codegen(int block_index) {
-  if (ReturnValue == nullptr) {
-    // Return expression does not return a value, only pass control flow
-    // Check if function type matches return type
-    if (CurFuncType->isVoidTy()){
-      return Builder.CreateRetVoid();
-    } else {
-      throw LogErrorV("Semantic Error: return type of function is non-void but return expression does not return a value");
+/// ASTWriter - lays the tree out in one buffer, children before parents, so
+/// every node can be built with the offsets of its children already known.
+class ASTWriter : public ASTVisitor<ASTWriter, uint64_t> {
+  std::vector<char> Out;
+  DenseMap<SymbolID, SymbolID> SymbolIndex; // SymbolID -> file's SymbolID
+  std::vector<SymbolID> FileSymbols;        // File's SymbolID -> SymbolID
+
+  template <typename T> static T *encode(uint64_t Offset) {
+    return reinterpret_cast<T *>(static_cast<uintptr_t>(Offset));
+  }
+
+  uint64_t reserve(size_t Size, size_t Align) {
+    uint64_t Offset = alignTo(Out.size(), Align);
+    Out.resize(Offset + Size);
+    return Offset;
+  }
+
+  template <typename T, typename... ArgTs> uint64_t emit(ArgTs &&...Args) {
+    uint64_t Offset = reserve(sizeof(T), alignof(T));
+    new (Out.data() + Offset) T(std::forward<ArgTs>(Args)...);
+    return Offset;
+  }
+
+  // Writes each element, then the array of their offsets
+  template <typename T> ArrayRef<T *> emitArray(ArrayRef<T *> Elems) {
+    if (Elems.empty())
+      return ArrayRef<T *>();
+    std::vector<T *> Encoded;
+    for (T *Elem : Elems)
+      Encoded.push_back(encode<T>(visit(Elem)));
+    uint64_t Offset = reserve(sizeof(T *) * Elems.size(), alignof(T *));
+    memcpy(Out.data() + Offset, Encoded.data(), sizeof(T *) * Elems.size());
+    return ArrayRef<T *>(encode<T *>(Offset), Elems.size());
+  }
+
+  template <typename T> T *emitChild(T *N) {
+    return N == nullptr ? nullptr : encode<T>(visit(N));
+  }
+
+  // Numbers the symbols the tree uses in the order they are first written
+  SymbolID symbol(SymbolID ID) {
+    auto Entry = SymbolIndex.try_emplace(ID, FileSymbols.size());
+    if (Entry.second)
+      FileSymbols.push_back(ID);
+    return Entry.first->second;
+  }
+
+public:
+  uint64_t visitInt(IntASTnode *N) { return emit<IntASTnode>(N->getVal()); }
+  uint64_t visitFloat(FloatASTnode *N) { return emit<FloatASTnode>(N->getVal()); }
+  uint64_t visitBool(BoolASTnode *N) { return emit<BoolASTnode>(N->getVal()); }
+  uint64_t visitVariable(VariableASTnode *N) {
+    return emit<VariableASTnode>(symbol(N->getName()));
+  }
+  uint64_t visitVariableAssignment(VariableAssignmentASTnode *N) {
+    return emit<VariableAssignmentASTnode>(emitChild(N->getVariable()),
+                                           emitChild(N->getVal()));
+  }
+  uint64_t visitVariableDeclaration(VariableDeclarationASTnode *N) {
+    return emit<VariableDeclarationASTnode>(symbol(N->getName()), N->getType());
+  }
+  uint64_t visitBlock(BlockASTnode *N) {
+    auto Decls = emitArray(N->getDeclarations());
+    auto Stmts = emitArray(N->getStatements());
+    return emit<BlockASTnode>(Decls, Stmts);
+  }
+  uint64_t visitBinary(BinaryASTnode *N) {
+    return emit<BinaryASTnode>(N->getOp(), emitChild(N->getLHS()),
+                               emitChild(N->getRHS()));
+  }
+  uint64_t visitUnary(UnaryASTnode *N) {
+    return emit<UnaryASTnode>(N->getOp(), emitChild(N->getOperand()));
+  }
+  uint64_t visitCast(CastASTnode *N) {
+    return emit<CastASTnode>(N->getExprType(), emitChild(N->getOperand()));
+  }
+  uint64_t visitCall(CallASTnode *N) {
+    auto Args = emitArray(N->getArgs());
+    return emit<CallASTnode>(symbol(N->getCallee()), Args);
+  }
+  uint64_t visitFunctionParam(FunctionParamASTnode *N) {
+    return emit<FunctionParamASTnode>(symbol(N->getName()), N->getType());
+  }
+  uint64_t visitFunctionPrototype(FunctionPrototypeASTnode *N) {
+    auto Args = emitArray(N->getArgs());
+    return emit<FunctionPrototypeASTnode>(symbol(N->getName()), N->getType(),
+                                          Args);
+  }
+  uint64_t visitFunctionDef(FunctionDefASTnode *N) {
+    return emit<FunctionDefASTnode>(emitChild(N->getPrototype()),
+                                    emitChild(N->getBody()));
+  }
+  uint64_t visitExtern(ExternASTnode *N) {
+    auto Params = emitArray(N->getParams());
+    return emit<ExternASTnode>(symbol(N->getName()), N->getType(), Params);
+  }
+  uint64_t visitIfExpr(IfExprASTnode *N) {
+    return emit<IfExprASTnode>(emitChild(N->getCond()), emitChild(N->getThen()),
+                               emitChild(N->getElse()));
+  }
+  uint64_t visitWhileExpr(WhileExprASTnode *N) {
+    return emit<WhileExprASTnode>(emitChild(N->getCond()),
+                                  emitChild(N->getBody()));
+  }
+  uint64_t visitReturnExpr(ReturnExprASTnode *N) {
+    return emit<ReturnExprASTnode>(emitChild(N->getReturnValue()));
+  }
+  uint64_t visitRoot(RootASTnode *N) {
+    auto Exts = emitArray(N->getExterns());
+    auto Decls = emitArray(N->getDecls());
+    return emit<RootASTnode>(Exts, Decls);
+  }
+
+  // Returns the whole cache file for Root
+  std::vector<char> write(RootASTnode *Root, uint64_t SourceHash,
+                          ArrayRef<uint64_t> DeclHashes) {
+    Out.clear();
+    reserve(sizeof(ASTCacheHeader), alignof(ASTCacheHeader));
+    ASTCacheHeader Header = {};
+    memcpy(Header.Magic, ASTCacheMagic, sizeof(Header.Magic));
+    Header.Version = ASTCacheVersion;
+    Header.LayoutHash = astLayoutHash();
+    Header.SourceHash = SourceHash;
+    Header.RootOffset = visit(Root);
+    Header.SymbolsOffset = Out.size();
+    Header.NumSymbols = FileSymbols.size();
+    for (SymbolID ID : FileSymbols) {
+      StringRef Name = Symbols.name(ID);
+      uint32_t Length = Name.size();
+      Out.insert(Out.end(), reinterpret_cast<char *>(&Length),
+                 reinterpret_cast<char *>(&Length) + sizeof(Length));
+      Out.insert(Out.end(), Name.begin(), Name.end());
     }
-  } else {
-    // Check if function type matches return type
-    Value *return_val = ReturnValue->codegen(block_index);
-    Type *return_val_type = return_val->getType();
-    if (return_val_type->isIntegerTy() != CurFuncType->isIntegerTy()) {
-      throw LogErrorV("Semantic Error: return type of function does not match type of return expression");
+    // Hashes that do not match the tree, as from --stream-tokens, are dropped
+    if (DeclHashes.size() ==
+        Root->getExterns().size() + Root->getDecls().size()) {
+      Header.NumHashes = DeclHashes.size();
+      Header.HashesOffset =
+          reserve(sizeof(uint64_t) * DeclHashes.size(), alignof(uint64_t));
+      memcpy(Out.data() + Header.HashesOffset, DeclHashes.data(),
+             sizeof(uint64_t) * DeclHashes.size());
     }
-    Builder.CreateRet(return_val);
-    return nullptr;
+    Header.FileSize = Out.size();
+    memcpy(Out.data(), &Header, sizeof(Header));
+    return std::move(Out);
   }
-}
+};
 
-Value *RootASTnode::codegen(int block_index) {
-  Value *RetVal;
-  Function *RetFunc;
-  // Call codegen on each extern and declaration
-  for (auto &Ext : Ext_List) {
-    RetFunc = Ext->codegen(block_index);
+// The tree of a cache file. A cache of an earlier version of the source is
+// still loaded, but only its unchanged declarations can be used: Root is then
+// for Parser::reuseDecls rather than codegen.
+struct CachedAST {
+  RootASTnode *Root = nullptr;
+  bool SourceMatches = false;
+  ArrayRef<uint64_t> DeclHashes;
+};
+
+/// ASTLoader - turns the offsets and SymbolIDs of a mapped cache file into
+/// pointers and IDs of this process, rebuilding each node where it lies.
+/// Fails on any offset that points outside the file or not below its parent,
+/// which is where the writer puts every child.
+class ASTLoader : public ASTVisitor<ASTLoader, bool> {
+  char *Base;
+  uint64_t Size;
+  uint64_t Limit; // Offset of the node being fixed up
+  std::vector<SymbolID> SymbolMap; // Writer's SymbolID -> this process's
+  BitVector Claimed; // Bytes already taken by a fixed-up node or array
+
+  template <typename T> bool decode(T *&Ptr, size_t Count = 1) {
+    uint64_t Offset = reinterpret_cast<uintptr_t>(Ptr);
+    if (Offset % alignof(T) != 0 || Offset < sizeof(ASTCacheHeader) ||
+        Offset >= Limit || Count > (Limit - Offset) / sizeof(T))
+      return false;
+    Ptr = reinterpret_cast<T *>(Base + Offset);
+    return true;
   }
-  for (auto &Decl : Decl_List) {
-    RetVal = Decl->codegen(block_index);
+
+  // Each node and array is fixed up in place exactly once, so a damaged file
+  // must not point two of them at overlapping bytes
+  bool claim(const void *Ptr, uint64_t Bytes) {
+    uint64_t Offset = static_cast<const char *>(Ptr) - Base;
+    if (Bytes == 0)
+      return true;
+    if (Claimed.find_first_in(Offset, Offset + Bytes) != -1)
+      return false;
+    Claimed.set(Offset, Offset + Bytes);
+    return true;
   }
-  return RetFunc;
-}
 
-//===----------------------------------------------------------------------===//
-// AST Printer
-//===----------------------------------------------------------------------===//
+  // Decodes a child pointer and fixes up the node it points to
+  template <typename T> bool child(T *&Ptr, bool Optional = false) {
+    if (Ptr == nullptr)
+      return Optional;
+    ASTnode *N = reinterpret_cast<ASTnode *>(Ptr);
+    if (!decode(N))
+      return false;
+    uint64_t Offset = reinterpret_cast<char *>(N) - Base;
+    size_t NodeSize = astNodeSize(N->getKind());
+    if (NodeSize == 0 || NodeSize > Limit - Offset || !claim(N, NodeSize))
+      return false;
+    uint64_t ParentLimit = Limit;
+    Limit = Offset;
+    bool Fixed = visit(N);
+    Limit = ParentLimit;
+    if (!Fixed || !isa<T>(N))
+      return false;
+    Ptr = cast<T>(N);
+    return true;
+  }
 
-inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                                     const ASTnode &ast) {
-  std::string ident_level = "";
-  os << ast.to_string(ident_level);
-  return os;
+  template <typename T> bool array(ArrayRef<T *> &Elems) {
+    if (Elems.empty()) {
+      Elems = ArrayRef<T *>();
+      return true;
+    }
+    T **Data = const_cast<T **>(Elems.data());
+    if (!decode(Data, Elems.size()) ||
+        !claim(Data, Elems.size() * sizeof(T *)))
+      return false;
+    for (size_t Index = 0; Index < Elems.size(); Index++)
+      if (!child(Data[Index]))
+        return false;
+    Elems = ArrayRef<T *>(Data, Elems.size());
+    return true;
+  }
+
+  bool symbol(SymbolID &ID) {
+    if (ID >= SymbolMap.size())
+      return false;
+    ID = SymbolMap[ID];
+    return true;
+  }
+
+  // Enums are stored as single bytes, which a damaged file can set to values
+  // no enumerator has
+  static bool valid(MiniCType Type) { return Type <= MiniCType::Bool; }
+  static bool valid(BinaryOpcode Op) { return Op <= BinaryOpcode::Rem; }
+  static bool valid(UnaryOpcode Op) { return Op <= UnaryOpcode::Not; }
+
+public:
+  bool visitInt(IntASTnode *N) { return true; }
+  bool visitFloat(FloatASTnode *N) { return true; }
+  bool visitBool(BoolASTnode *N) { return true; }
+  bool visitVariable(VariableASTnode *N) {
+    SymbolID Name = N->getName();
+    if (!symbol(Name))
+      return false;
+    new (N) VariableASTnode(Name);
+    return true;
+  }
+  bool visitVariableAssignment(VariableAssignmentASTnode *N) {
+    VariableASTnode *Var = N->getVariable();
+    ASTnode *Val = N->getVal();
+    if (!child(Var) || !child(Val))
+      return false;
+    new (N) VariableAssignmentASTnode(Var, Val);
+    return true;
+  }
+  bool visitVariableDeclaration(VariableDeclarationASTnode *N) {
+    SymbolID Name = N->getName();
+    if (!symbol(Name) || !valid(N->getType()))
+      return false;
+    new (N) VariableDeclarationASTnode(Name, N->getType());
+    return true;
+  }
+  bool visitBlock(BlockASTnode *N) {
+    auto Decls = N->getDeclarations();
+    auto Stmts = N->getStatements();
+    if (!array(Decls) || !array(Stmts))
+      return false;
+    new (N) BlockASTnode(Decls, Stmts);
+    return true;
+  }
+  bool visitBinary(BinaryASTnode *N) {
+    ASTnode *LHS = N->getLHS(), *RHS = N->getRHS();
+    if (!valid(N->getOp()) || !child(LHS) || !child(RHS))
+      return false;
+    new (N) BinaryASTnode(N->getOp(), LHS, RHS);
+    return true;
+  }
+  bool visitUnary(UnaryASTnode *N) {
+    ASTnode *Operand = N->getOperand();
+    if (!valid(N->getOp()) || !child(Operand))
+      return false;
+    new (N) UnaryASTnode(N->getOp(), Operand);
+    return true;
+  }
+  bool visitCast(CastASTnode *N) {
+    ASTnode *Operand = N->getOperand();
+    if (!valid(N->getExprType()) || !child(Operand))
+      return false;
+    new (N) CastASTnode(N->getExprType(), Operand);
+    return true;
+  }
+  bool visitCall(CallASTnode *N) {
+    SymbolID Callee = N->getCallee();
+    auto Args = N->getArgs();
+    if (!symbol(Callee) || !array(Args))
+      return false;
+    new (N) CallASTnode(Callee, Args);
+    return true;
+  }
+  bool visitFunctionParam(FunctionParamASTnode *N) {
+    SymbolID Name = N->getName();
+    if (!symbol(Name) || !valid(N->getType()))
+      return false;
+    new (N) FunctionParamASTnode(Name, N->getType());
+    return true;
+  }
+  bool visitFunctionPrototype(FunctionPrototypeASTnode *N) {
+    SymbolID Name = N->getName();
+    auto Args = N->getArgs();
+    if (!symbol(Name) || !valid(N->getType()) || !array(Args))
+      return false;
+    new (N) FunctionPrototypeASTnode(Name, N->getType(), Args);
+    return true;
+  }
+  bool visitFunctionDef(FunctionDefASTnode *N) {
+    // The cache holds no lazy bodies, so a null one is damage, not a body
+    // still to be parsed
+    FunctionPrototypeASTnode *Proto = N->getPrototype();
+    BlockASTnode *Body = N->getParsedBody();
+    if (!child(Proto) || !child(Body))
+      return false;
+    new (N) FunctionDefASTnode(Proto, Body);
+    return true;
+  }
+  bool visitExtern(ExternASTnode *N) {
+    SymbolID Name = N->getName();
+    auto Params = N->getParams();
+    if (!symbol(Name) || !valid(N->getType()) || !array(Params))
+      return false;
+    new (N) ExternASTnode(Name, N->getType(), Params);
+    return true;
+  }
+  bool visitIfExpr(IfExprASTnode *N) {
+    ASTnode *Cond = N->getCond();
+    BlockASTnode *Then = N->getThen(), *Else = N->getElse();
+    if (!child(Cond) || !child(Then) || !child(Else, /*Optional=*/true))
+      return false;
+    new (N) IfExprASTnode(Cond, Then, Else);
+    return true;
+  }
+  bool visitWhileExpr(WhileExprASTnode *N) {
+    ASTnode *Cond = N->getCond(), *Body = N->getBody();
+    if (!child(Cond) || !child(Body))
+      return false;
+    new (N) WhileExprASTnode(Cond, Body);
+    return true;
+  }
+  bool visitReturnExpr(ReturnExprASTnode *N) {
+    ASTnode *Value = N->getReturnValue();
+    if (!child(Value, /*Optional=*/true))
+      return false;
+    new (N) ReturnExprASTnode(Value);
+    return true;
+  }
+  bool visitRoot(RootASTnode *N) {
+    auto Exts = N->getExterns();
+    auto Decls = N->getDecls();
+    if (!array(Exts) || !array(Decls))
+      return false;
+    new (N) RootASTnode(Exts, Decls);
+    return true;
+  }
+
+  // Fixes up the mapped file and returns its tree, with a null Root if the
+  // file is not a cache for this build
+  CachedAST load(char *Data, uint64_t FileSize, uint64_t SourceHash) {
+    Base = Data;
+    Size = FileSize;
+    ASTCacheHeader Header;
+    if (Size < sizeof(Header))
+      return CachedAST();
+    memcpy(&Header, Base, sizeof(Header));
+    if (memcmp(Header.Magic, ASTCacheMagic, sizeof(Header.Magic)) != 0 ||
+        Header.Version != ASTCacheVersion ||
+        Header.LayoutHash != astLayoutHash() || Header.FileSize != Size ||
+        Header.SymbolsOffset > Size || Header.HashesOffset > Size ||
+        Header.SymbolsOffset > std::numeric_limits<unsigned>::max() ||
+        Header.HashesOffset % alignof(uint64_t) != 0 ||
+        Header.NumHashes > (Size - Header.HashesOffset) / sizeof(uint64_t))
+      return CachedAST();
+
+    const char *Ptr = Base + Header.SymbolsOffset, *End = Base + Size;
+    SymbolMap.clear();
+    for (uint32_t ID = 0; ID < Header.NumSymbols; ID++) {
+      uint32_t Length;
+      if (size_t(End - Ptr) < sizeof(Length))
+        return CachedAST();
+      memcpy(&Length, Ptr, sizeof(Length));
+      Ptr += sizeof(Length);
+      if (size_t(End - Ptr) < Length)
+        return CachedAST();
+      SymbolMap.push_back(Symbols.intern(StringRef(Ptr, Length)));
+      Ptr += Length;
+    }
+
+    Limit = Header.SymbolsOffset;
+    Claimed.clear();
+    Claimed.resize(Limit);
+    CachedAST Cached;
+    Cached.Root = reinterpret_cast<RootASTnode *>(
+        static_cast<uintptr_t>(Header.RootOffset));
+    if (!child(Cached.Root))
+      return CachedAST();
+    Cached.SourceMatches = Header.SourceHash == SourceHash;
+    Cached.DeclHashes = ArrayRef<uint64_t>(
+        reinterpret_cast<uint64_t *>(Base + Header.HashesOffset),
+        Header.NumHashes);
+    return Cached;
+  }
+};
+
+// Loads the cached tree of Source from Path into Ctx. Root is null if there is
+// no usable cache.
+static CachedAST readASTCache(StringRef Path, StringRef Source,
+                              ASTContext &Ctx) {
+  int FD;
+  if (sys::fs::openFileForRead(Path, FD))
+    return CachedAST();
+  uint64_t Size = 0;
+  sys::fs::file_status Status;
+  if (!sys::fs::status(FD, Status))
+    Size = Status.getSize();
+  std::error_code EC;
+  auto Region = std::make_unique<sys::fs::mapped_file_region>(
+      sys::fs::convertFDToNativeFile(FD), sys::fs::mapped_file_region::priv,
+      Size, 0, EC);
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (Size == 0 || EC)
+    return CachedAST();
+  CachedAST Cached = ASTLoader().load(Region->data(), Size, xxHash64(Source));
+  if (Cached.Root != nullptr)
+    Ctx.adoptMapping(std::move(Region));
+  return Cached;
+}
+
+// Saves the tree of Source to Path. A cache that cannot be written is skipped.
+// The old cache may still be mapped, holding reused declarations, so the new
+// one is written beside it and renamed over it.
+static void writeASTCache(StringRef Path, StringRef Source, RootASTnode *Root,
+                          ArrayRef<uint64_t> DeclHashes) {
+  std::vector<char> Data =
+      ASTWriter().write(Root, xxHash64(Source), DeclHashes);
+  std::string TempPath = (Path + ".tmp").str();
+  std::error_code EC;
+  {
+    raw_fd_ostream Out(TempPath, EC, sys::fs::OF_None);
+    if (EC)
+      return;
+    Out.write(Data.data(), Data.size());
+    Out.close();
+    if (Out.has_error()) {
+      Out.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  sys::fs::rename(TempPath, Path);
 }
 
 //===----------------------------------------------------------------------===//
@@ -2485,18 +5183,80 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
 //===----------------------------------------------------------------------===//
 
 int main(int argc, char **argv) {
-  if (argc == 2) {
-    pFile = fopen(argv[1], "r");
-    if (pFile == NULL)
-      perror("Error opening file");
-  } else {
-    std::cout << "Usage: ./code InputFile\n";
+  const char *InputFile = nullptr;
+  bool PreTokenize = true;
+  bool DumpAST = false;
+  bool LazyBodies = false;
+  unsigned ParseThreads = 1;
+  bool UseASTCache = false;
+  bool SemaOnly = false;
+  bool FoldConstants = false;
+  bool FlatLayout = false;
+  bool ExportsGiven = false;
+  SmallVector<StringRef, 8> Exports;
+  for (int i = 1; i < argc; i++) {
+    StringRef Arg = argv[i];
+    if (Arg == "--stream-tokens") {
+      // Lex on demand instead of tokenizing the whole file first
+      PreTokenize = false;
+    } else if (Arg == "--lazy-bodies") {
+      // Parse each function body only when codegen first needs it
+      LazyBodies = true;
+    } else if (Arg.consume_front("--parse-threads=")) {
+      // Parse function bodies on this many threads, 0 for one per core
+      if (Arg.getAsInteger(10, ParseThreads)) {
+        errs() << "Invalid thread count: " << argv[i] << "\n";
+        return 1;
+      }
+      if (ParseThreads == 0)
+        ParseThreads = std::max(1u, std::thread::hardware_concurrency());
+    } else if (Arg == "--ast-cache") {
+      // Reuse whatever of the tree in InputFile.astc this source still has
+      UseASTCache = true;
+    } else if (Arg == "--sema-only") {
+      // Stop after checking the program, without building any IR
+      SemaOnly = true;
+    } else if (Arg == "--fold-constants") {
+      // Fold literal operators and prune branches before building the IR
+      FoldConstants = true;
+    } else if (Arg == "--flat-ast") {
+      // Lower the checked tree to a flat array and build the IR from that
+      FlatLayout = true;
+    } else if (Arg.consume_front("--export=")) {
+      // Lower only these functions and the ones they call
+      ExportsGiven = true;
+      size_t NumExports = Exports.size();
+      Arg.split(Exports, ',', -1, false);
+      if (Exports.size() == NumExports) {
+        errs() << "Invalid export list: " << argv[i] << "\n";
+        return 1;
+      }
+    } else if (Arg == "--dump-ast") {
+      // Print the tree to stdout after parsing
+      DumpAST = true;
+    } else if (InputFile == nullptr) {
+      InputFile = argv[i];
+    } else {
+      InputFile = nullptr;
+      break;
+    }
+  }
+  if (InputFile == nullptr) {
+    std::cout << "Usage: ./code [--stream-tokens] [--lazy-bodies] [--parse-threads=N] [--ast-cache] [--sema-only] [--fold-constants] [--flat-ast] [--export=fn,...] [--dump-ast] InputFile\n";
     return 1;
   }
 
-  // initialize line number and column numbers to zero
-  lineNo = 1;
-  columnNo = 1;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> FileOrErr =
+      MemoryBuffer::getFileOrSTDIN(InputFile);
+  if (std::error_code EC = FileOrErr.getError()) {
+    errs() << "Error opening file: " << EC.message() << "\n";
+    return 1;
+  }
+  if ((*FileOrErr)->getBufferSize() > UINT32_MAX) {
+    errs() << "Error opening file: source files are limited to 4 GiB\n";
+    return 1;
+  }
+  Lexer Lex(std::move(*FileOrErr));
 
   // Make the module, which holds all the code.
   TheModule = std::make_unique<Module>("mini-c", TheContext);
@@ -2504,13 +5264,60 @@ int main(int argc, char **argv) {
   TheContext.setOpaquePointers(false);
   // Run the parser now.
 
-  std::unique_ptr<RootASTnode> program;
-  program = parser();
-  std::string ident_level = "";
-  llvm::outs() << program->to_string(ident_level) << "\n";
+  // Lazily parsed bodies are parsed by P during codegen, so Lex and P must
+  // outlive the tree
+  ASTContext Ctx;
+  Parser P(Lex, Ctx, PreTokenize, LazyBodies, ParseThreads);
+  RootASTnode *program = nullptr;
+  std::string CachePath = std::string(InputFile) + ".astc";
+  if (UseASTCache) {
+    CachedAST Cached = readASTCache(CachePath, Lex.getBuffer(), Ctx);
+    if (Cached.SourceMatches) {
+      program = Cached.Root;
+    } else if (Cached.Root != nullptr) {
+      // The source was edited, so parse only the declarations that changed
+      P.reuseDecls(Cached.Root, Cached.DeclHashes);
+    }
+  }
+  if (program == nullptr) {
+    program = P.parse();
+    if (UseASTCache && program != nullptr) {
+      writeASTCache(CachePath, Lex.getBuffer(), program, P.getDeclHashes());
+    }
+  }
+  if (DumpAST) {
+    if (FlatLayout) {
+      llvm::outs() << FlatAST(program) << "\n";
+    } else {
+      llvm::outs() << *program << "\n";
+    }
+  }
   fprintf(stderr, "Parsing Finished\n");
-  int block_index = 0;
-  program->codegen(block_index);
+  // Functions the exports never call are dropped before they are checked
+  if (ExportsGiven && !removeDeadFunctions(Ctx, program, Exports)) {
+    return 1;
+  }
+  // Report every error in the program before building any IR
+  if (!Sema(Ctx).check(program)) {
+    return 1;
+  }
+  if (SemaOnly) {
+    return 0;
+  }
+  if (FoldConstants) {
+    Simplifier(Ctx).simplify(program);
+    // Pruning a constant branch can drop the last call to a function
+    if (ExportsGiven) {
+      removeDeadFunctions(Ctx, program, Exports);
+    }
+  }
+  if (FlatLayout) {
+    FlatAST Flat(program);
+    FlatCodegen(Flat).emit(Flat.getRoot());
+  } else {
+    int block_index = 0;
+    program->codegen(block_index);
+  }
 
   //********************* Start printing final IR **************************
   // Print out all of the generated code into a file called output.ll
@@ -2525,7 +5332,5 @@ int main(int argc, char **argv) {
   TheModule->print(errs(), nullptr); // print IR to terminal
   TheModule->print(dest, nullptr);
   //********************* End printing final IR ****************************
-
-  fclose(pFile); // close the file that contains the code that was parsed
   return 0;
 }
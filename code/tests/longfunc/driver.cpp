@@ -0,0 +1,34 @@
+#include <iostream>
+#include <cstdio>
+
+// clang++ driver.cpp output.ll -o longfunc
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+extern "C" DLLEXPORT int print_int(int X) {
+  fprintf(stderr, "%d\n", X);
+  return 0;
+}
+
+extern "C" DLLEXPORT float print_float(float X) {
+  fprintf(stderr, "%f\n", X);
+  return 0;
+}
+
+extern "C" {
+    int longfunc();
+}
+
+int main() {
+    if (longfunc() == 1000000) {
+    	std::cout << "PASSED Result: " << longfunc() << std::endl;
+    }
+    else {
+    	std::cout << "FAILED Result: " << longfunc() << std::endl;
+    }
+    
+}
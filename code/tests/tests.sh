@@ -73,6 +73,12 @@ rm -rf output.ll while
 $CLANG driver.cpp output.ll -o while
 validate "./while"
 
+# Same program with its constants folded and propagated
+rm -rf output.ll while
+"$COMP" --fold-constants ./while.c
+$CLANG driver.cpp output.ll -o while
+validate "./while"
+
 cd ../void
 pwd
 rm -rf output.ll void
@@ -87,6 +93,22 @@ rm -rf output.ll cosine
 $CLANG driver.cpp output.ll -o cosine
 validate "./cosine"
 
+rm -rf output.ll cosine
+"$COMP" --fold-constants ./cosine.c
+$CLANG driver.cpp output.ll -o cosine
+validate "./cosine"
+
+# The flat layout gives the same IR and the same dump as the tree
+rm -rf output.ll tree.ll cosine
+"$COMP" --dump-ast ./cosine.c > tree.txt 2> /dev/null
+mv output.ll tree.ll
+"$COMP" --dump-ast --flat-ast ./cosine.c > flat.txt 2> /dev/null
+cmp tree.ll output.ll
+cmp tree.txt flat.txt
+$CLANG driver.cpp output.ll -o cosine
+validate "./cosine"
+rm -rf tree.ll tree.txt flat.txt
+
 cd ../unary
 pwd
 rm -rf output.ll unary
@@ -108,6 +130,20 @@ rm -rf output.ll rfact
 $CLANG driver.cpp output.ll -o rfact
 validate "./rfact"
 
+# Only the function the driver calls and the ones it calls in turn are lowered.
+# The body nothing calls is never parsed, so its syntax error goes unnoticed.
+rm -rf output.ll rfact exported.c
+echo "extern int unusedext(int x);" > exported.c
+cat rfact.c >> exported.c
+echo "int unused(int n) { return unusedext(n) + rfact(n); }" >> exported.c
+echo "int broken(int n) { return n + ; }" >> exported.c
+"$COMP" --lazy-bodies --export=rfact ./exported.c
+if grep -qE "unused|broken" output.ll; then echo "TEST FAILED *****"; exit 1; fi
+$CLANG driver.cpp output.ll -o rfact
+validate "./rfact"
+if "$COMP" --export= ./exported.c > /dev/null 2>&1; then echo "TEST FAILED *****"; exit 1; fi
+rm -rf exported.c
+
 cd ../palindrome
 pwd
 rm -rf output.ll palindrome
@@ -115,4 +151,111 @@ rm -rf output.ll palindrome
 $CLANG driver.cpp output.ll -o palindrome
 validate "./palindrome"
 
+# Same program with each function body parsed only when codegen reaches it
+rm -rf output.ll palindrome
+"$COMP" --lazy-bodies ./palindrome.c
+$CLANG driver.cpp output.ll -o palindrome
+validate "./palindrome"
+
+# And with the function bodies parsed on worker threads
+rm -rf output.ll palindrome
+"$COMP" --parse-threads=4 ./palindrome.c
+$CLANG driver.cpp output.ll -o palindrome
+validate "./palindrome"
+
+# The first syntax error in the source is reported, as without threads, even
+# when it is in a body and a later one is at the top level
+printf 'int f() { int x; x = ; return 1; }\nint g( { return 2; }\n' > bad.c
+"$COMP" ./bad.c > /dev/null 2> serial.txt || true
+"$COMP" --parse-threads=4 ./bad.c > /dev/null 2> threaded.txt || true
+cmp serial.txt threaded.txt
+rm -rf bad.c serial.txt threaded.txt
+
+# Once writing the AST cache and once compiling from it
+rm -rf output.ll palindrome palindrome.c.astc
+"$COMP" --ast-cache ./palindrome.c
+rm -rf output.ll
+"$COMP" --ast-cache ./palindrome.c
+$CLANG driver.cpp output.ll -o palindrome
+validate "./palindrome"
+rm -rf palindrome.c.astc
+
+# After an edit only the changed declarations are parsed, the rest come from
+# the cache
+rm -rf output.ll palindrome edited.c edited.c.astc
+cp palindrome.c edited.c
+"$COMP" --ast-cache ./edited.c
+echo "int edited(int x) { return x + 1; }" >> edited.c
+rm -rf output.ll
+"$COMP" --ast-cache ./edited.c
+$CLANG driver.cpp output.ll -o palindrome
+validate "./palindrome"
+rm -rf edited.c edited.c.astc
+
+# A damaged cache is dropped and the source reparsed, whether it is truncated
+# or has any one word zeroed, child offsets included. Zeroing a symbol can
+# leave a tree Sema rejects, but nothing may crash.
+rm -rf output.ll palindrome palindrome.c.astc good.astc
+"$COMP" --ast-cache ./palindrome.c > /dev/null 2>&1
+cp palindrome.c.astc good.astc
+head -c 200 good.astc > palindrome.c.astc
+rm -rf output.ll
+"$COMP" --ast-cache ./palindrome.c > /dev/null 2>&1
+$CLANG driver.cpp output.ll -o palindrome
+validate "./palindrome"
+for ((i = 0; i < $(wc -c < good.astc) / 8; i++)); do
+  cp good.astc palindrome.c.astc
+  dd if=/dev/zero of=palindrome.c.astc bs=8 seek=$i count=1 conv=notrunc 2> /dev/null
+  "$COMP" --ast-cache ./palindrome.c > /dev/null 2>&1 || [ $? -eq 1 ]
+done
+rm -rf palindrome.c.astc good.astc
+
+# Checking the program alone builds no IR
+rm -rf output.ll
+"$COMP" --sema-only ./palindrome.c
+if [ -f output.ll ]; then echo "TEST FAILED *****"; exit 1; fi
+
+cd ../longfunc
+pwd
+rm -rf output.ll longfunc longfunc.c
+# Stress test: one function with a million statements, generated here rather
+# than checked in. Parse depth must not grow with the length of a list.
+awk 'BEGIN {
+  print "int longfunc() {"; print "  int x;"; print "  x = 0;"
+  for (i = 0; i < 1000000; i++) print "  x = x + 1;"
+  print "  return x;"; print "}"
+}' > longfunc.c
+"$COMP" ./longfunc.c > /dev/null 2>&1
+$CLANG driver.cpp output.ll -o longfunc
+validate "./longfunc"
+
+# 10k loops in a row, each closing its scope when it ends, and a local of a
+# loop is not visible after it
+rm -rf loops.c
+awk 'BEGIN {
+  print "int loops(int n) {"; print "  int x;"; print "  x = 0;"
+  for (i = 0; i < 10000; i++)
+    print "  while (x < n) { int y" i "; y" i " = x; x = x + y" i " + 1; }"
+  print "  return x;"; print "}"
+}' > loops.c
+"$COMP" --sema-only ./loops.c > /dev/null 2>&1
+echo "int leak() { while (true) { int y; y = 1; } if (true) { y = 2; } return 0; }" > loops.c
+if "$COMP" --sema-only ./loops.c > /dev/null 2>&1; then echo "TEST FAILED *****"; exit 1; fi
+# A block on its own scopes its locals too
+echo "int leak() { { int y; y = 1; } y = 3; return 0; }" > loops.c
+if "$COMP" --sema-only ./loops.c > /dev/null 2>&1; then echo "TEST FAILED *****"; exit 1; fi
+rm -rf loops.c
+
+# A float literal too small for a float rounds to zero rather than failing
+echo "float tiny() { return 0.$(printf '0%.0s' $(seq 47))1; }" > tiny.c
+"$COMP" ./tiny.c > /dev/null 2>&1
+# A float literal with no digits is malformed, not out of range, and Mini-C
+# has no exponents
+echo "float dot() { return .; }" > tiny.c
+if "$COMP" ./tiny.c > /dev/null 2> err.txt; then echo "TEST FAILED *****"; exit 1; fi
+grep -q "malformed float literal" err.txt
+echo "float exp() { return 1e; }" > tiny.c
+if "$COMP" ./tiny.c > /dev/null 2>&1; then echo "TEST FAILED *****"; exit 1; fi
+rm -rf tiny.c err.txt
+
 echo "***** ALL TESTS PASSED *****"